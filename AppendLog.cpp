@@ -0,0 +1,201 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Log file appended by many threads
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <unistd.h>
+#include "AppendLog.hpp"
+
+using namespace rohan;
+
+/******************************************************************************/
+
+static const uint8_t MARKER[4]={0xf7, 'L', 'O', 'G'};
+static const size_t CHUNK_SIZE=65536;
+
+static void check(bool success) {
+    if (!success)
+        throw std::system_error(errno, std::generic_category());
+}
+
+void rohan::writeLogRecord(Writer &sink, const void * data, size_t length) {
+    sink.write(MARKER, sizeof(MARKER));
+    writeChecksummedBlock(sink, data, length);
+}
+
+/******************************************************************************/
+
+AppendLog::AppendLog(const char * filename, int flags) {
+    // With O_APPEND, pwrite() would ignore the offset
+    fd=open(filename, flags&~O_APPEND, 0644);
+    check(fd>=0);
+    off_t size=lseek(fd, 0, SEEK_END);
+    if (size<0) {
+        int error=errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category());
+    }
+    end.store(size);
+}
+
+AppendLog::~AppendLog() {
+    close(fd);
+}
+
+void AppendLog::write(const void * blocks, size_t length) {
+    const uint8_t * data=static_cast<const uint8_t *>(blocks);
+    uint64_t offset=end.fetch_add(length, std::memory_order_relaxed);
+    while (length>0) {
+        ssize_t n=pwrite(fd, data, length, offset);
+        if (n<0) {
+            check(errno==EINTR);
+            continue;
+        }
+        data+=n;
+        offset+=n;
+        length-=n;
+    }
+}
+
+void AppendLog::sync() {
+    check(!fdatasync(fd));
+}
+
+/******************************************************************************/
+
+LogAppender::LogAppender(AppendLog &log, size_t bufferSize) :
+        log(log), bufferSize(bufferSize), records(bufferSize+bufferSize/8) {}
+
+LogAppender::~LogAppender() {
+    try {
+        flush();
+    }
+    catch (...) {}
+}
+
+void LogAppender::flush() {
+    const std::vector<uint8_t> &buffer=records.getBuffer();
+    if (!buffer.empty()) {
+        log.write(buffer.data(), buffer.size());
+        records.clear();
+    }
+}
+
+/******************************************************************************/
+
+LogReader::LogReader(Reader &source, size_t maxRecordSize) : source(source),
+        maxRecordSize(maxRecordSize), start(0), exhausted(false), position(0),
+        skipped(0) {}
+
+bool LogReader::end() {
+    while (position==record.size())
+        if (!populate())
+            return true;
+    return false;
+}
+
+size_t LogReader::read(void * to, size_t length) {
+    uint8_t * destination=static_cast<uint8_t *>(to);
+    size_t result=0;
+    while (length) {
+        if (position==record.size()) {
+            if (!populate())
+                break;
+            continue;
+        }
+        size_t portion=std::min(length, record.size()-position);
+        memcpy(destination, &record[position], portion);
+        position+=portion;
+        destination+=portion;
+        length-=portion;
+        result+=portion;
+    }
+    return result;
+}
+
+size_t LogReader::skip(size_t length) {
+    size_t result=0;
+    while (length) {
+        if (position==record.size()) {
+            if (!populate())
+                break;
+            continue;
+        }
+        size_t portion=std::min(length, record.size()-position);
+        position+=portion;
+        length-=portion;
+        result+=portion;
+    }
+    return result;
+}
+
+bool LogReader::populate() {
+    for (;;) {
+        if (!fill(sizeof(MARKER)+1)) {
+            skipped+=window.size()-start;
+            start=window.size();
+            return false;
+        }
+        
+        // Look for the next marker
+        const uint8_t * head=&window[start];
+        if (memcmp(head, MARKER, sizeof(MARKER))) {
+            const void * next=memchr(head+1, MARKER[0], window.size()-start-1);
+            size_t distance=next?static_cast<const uint8_t *>(next)-head:window.size()-start;
+            start+=distance;
+            skipped+=distance;
+            continue;
+        }
+        
+        // Length of the block
+        size_t nPrefix=0;
+        uint64_t length=0;
+        bool valid=false;
+        while (nPrefix<10&&fill(sizeof(MARKER)+nPrefix+1)) {
+            uint8_t byte=window[start+sizeof(MARKER)+nPrefix];
+            length|=uint64_t(byte&0x7f)<<(7*nPrefix++);
+            if (!(byte&0x80)) {
+                valid=true;
+                break;
+            }
+        }
+        
+        // A damaged record is skipped byte by byte, it may hide a valid one
+        size_t size=sizeof(MARKER)+nPrefix+length+4;
+        if (valid&&length<=maxRecordSize&&fill(size)) {
+            const uint8_t * prefix=&window[start+sizeof(MARKER)];
+            const uint8_t * data=prefix+nPrefix;
+            const uint8_t * suffix=data+length;
+            uint32_t expected=suffix[0]|(suffix[1]<<8)|(suffix[2]<<16)|(uint32_t(suffix[3])<<24);
+            if (crc32c(data, length, crc32c(prefix, nPrefix))==expected) {
+                record.assign(data, data+length);
+                position=0;
+                start+=size;
+                return true;
+            }
+        }
+        start++;
+        skipped++;
+    }
+}
+
+bool LogReader::fill(size_t length) {
+    while (window.size()-start<length) {
+        if (exhausted)
+            return false;
+        window.erase(window.begin(), window.begin()+start);
+        start=0;
+        size_t size=window.size();
+        window.resize(size+CHUNK_SIZE);
+        size_t n=source.read(&window[size], CHUNK_SIZE);
+        window.resize(size+n);
+        exhausted=!n;
+    }
+    return true;
+}
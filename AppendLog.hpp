@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Log file appended by many threads
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_APPENDLOG_HPP
+#define __ROHAN_APPENDLOG_HPP
+
+#include <atomic>
+#include <fcntl.h>
+#include "ByteArraySerialization.hpp"
+#include "ChecksummedSerialization.hpp"
+
+namespace rohan {
+
+/** Write a log record: a synchronization marker and a block protected by
+    CRC32C (see writeChecksummedBlock()) **/
+void writeLogRecord(Writer &sink, const void * data, size_t length);
+
+/** Log file which is appended by many threads without locking. Every
+    record is written by writeLogRecord(), the log is read with LogReader:
+        LogReader records(file);
+        while (!records.end())
+            Record record(records);
+    A thread reserves a range of the file atomically and writes its records
+    there with pwrite(). Ranges which are reserved but not written, e.g.
+    after a failed write or a crash, are skipped by the reader. **/
+class AppendLog {
+public:
+    /** Open a log file, new records are appended after the existing ones **/
+    explicit AppendLog(const char * filename, int flags=O_WRONLY|O_CREAT);
+    AppendLog(const AppendLog &)=delete;
+    AppendLog &operator =(const AppendLog &)=delete;
+    /** Close the file **/
+    ~AppendLog();
+    /** Returns the size of the log including the reserved ranges **/
+    uint64_t size() const { return end.load(std::memory_order_relaxed); }
+    /** Append a record **/
+    template <class T>
+    void append(const T &value) {
+        thread_local ByteArrayWriter payload, record;
+        payload.clear();
+        record.clear();
+        payload | value;
+        writeLogRecord(record, payload.getBuffer().data(), payload.getBuffer().size());
+        write(record.getBuffer().data(), record.getBuffer().size());
+    }
+    /** Append complete records written by writeLogRecord() **/
+    void write(const void * blocks, size_t length);
+    /** Flush the written data to the storage device **/
+    void sync();
+    
+private:
+    int fd;
+    std::atomic<uint64_t> end;
+};
+
+/** Collects records of a thread and appends them to the log in batches. An
+    appender must be used by one thread at a time. **/
+class LogAppender {
+public:
+    /** Create an appender, which writes when bufferSize bytes are collected **/
+    explicit LogAppender(AppendLog &log, size_t bufferSize=65536);
+    /** Write remaining records. Call flush() explicitly in order to get errors. **/
+    ~LogAppender();
+    /** Add a record **/
+    template <class T>
+    void append(const T &value) {
+        payload.clear();
+        payload | value;
+        writeLogRecord(records, payload.getBuffer().data(), payload.getBuffer().size());
+        if (records.getBuffer().size()>=bufferSize)
+            flush();
+    }
+    /** Write the collected records to the log **/
+    void flush();
+    
+private:
+    AppendLog &log;
+    size_t bufferSize;
+    ByteArrayWriter payload;
+    ByteArrayWriter records;
+};
+
+/** Reads records written to an AppendLog as one stream of data. Damaged
+    ranges are skipped up to the next valid record, so a failed or
+    interrupted write loses only its own records. **/
+class LogReader : public Reader {
+public:
+    /** Create a reader, longer records are considered damaged **/
+    explicit LogReader(Reader &source, size_t maxRecordSize=1<<24);
+    /** Returns true if there are no more records **/
+    bool end();
+    /** Returns the number of bytes skipped as damaged **/
+    uint64_t getSkipped() const { return skipped; }
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    
+private:
+    bool populate();
+    bool fill(size_t length);
+    
+    Reader &source;
+    size_t maxRecordSize;
+    std::vector<uint8_t> window;
+    size_t start;
+    bool exhausted;
+    std::vector<uint8_t> record;
+    size_t position;
+    uint64_t skipped;
+};
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization to non-blocking sockets
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "AsyncSerialization.hpp"
+
+using namespace rohan;
+
+/******************************************************************************/
+
+static const size_t PORTION_SIZE=65536;
+
+static bool wouldBlock() {
+    if (errno==EAGAIN||errno==EWOULDBLOCK)
+        return true;
+    if (errno!=EINTR)
+        throw std::system_error(errno, std::generic_category());
+    return false;
+}
+
+/******************************************************************************/
+
+AsyncSocketWriter::AsyncSocketWriter(int socket) : socket(socket), head(0) {}
+
+void AsyncSocketWriter::write(const void * from, size_t length) {
+    const uint8_t * data=reinterpret_cast<const uint8_t *>(from);
+    queue.insert(queue.end(), data, data+length);
+}
+
+size_t AsyncSocketWriter::send() {
+    size_t result=0;
+    while (pending()) {
+        ssize_t n=::send(socket, &queue[head], pending(), MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (n<0) {
+            if (wouldBlock())
+                break;
+            continue;
+        }
+        head+=n;
+        result+=n;
+    }
+    
+    // Reclaim the space of sent data
+    if (head==queue.size()) {
+        queue.clear();
+        head=0;
+    }
+    else if (head>=PORTION_SIZE&&head*2>=queue.size()) {
+        queue.erase(queue.begin(), queue.begin()+head);
+        head=0;
+    }
+    return result;
+}
+
+uint32_t AsyncSocketWriter::getEvents() const {
+    return pending()?uint32_t(EPOLLOUT):0;
+}
+
+/******************************************************************************/
+
+AsyncSocketReader::AsyncSocketReader(int socket, size_t maxFrameSize) :
+        socket(socket), closed(false), decoder(maxFrameSize),
+        buffer(PORTION_SIZE) {}
+
+size_t AsyncSocketReader::receivePortion() {
+    for (;;) {
+        ssize_t n=::recv(socket, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (n>0)
+            return n;
+        if (!n) {
+            closed=true;
+            return 0;
+        }
+        if (wouldBlock())
+            return 0;
+    }
+}
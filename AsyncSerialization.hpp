@@ -0,0 +1,76 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization to non-blocking sockets
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_ASYNCSERIALIZATION_HPP
+#define __ROHAN_ASYNCSERIALIZATION_HPP
+
+#include "FrameSerialization.hpp"
+
+namespace rohan {
+
+/** Writer for a non-blocking socket. Written data are queued and sent as
+    the socket becomes writable, short writes are not errors. **/
+class AsyncSocketWriter : public Writer {
+public:
+    /** Initialize with a socket descriptor (not owned) **/
+    explicit AsyncSocketWriter(int socket);
+    /** Returns the socket descriptor **/
+    int getSocket() const { return socket; }
+    /** Queue a portion of data **/
+    void write(const void * from, size_t length) override;
+    /** Send as much queued data as the socket accepts, returns the number of
+        bytes sent. Throws std::system_error on socket errors. **/
+    size_t send();
+    /** Same as send() **/
+    void flush() override { send(); }
+    /** Returns the number of queued bytes **/
+    size_t pending() const { return queue.size()-head; }
+    /** Returns epoll events to wait for: EPOLLOUT while data are queued **/
+    uint32_t getEvents() const;
+    
+private:
+    int socket;
+    size_t head;
+    std::vector<uint8_t> queue;
+};
+
+/** Reader of frames from a non-blocking socket **/
+class AsyncSocketReader {
+public:
+    /** Initialize with a socket descriptor (not owned) **/
+    explicit AsyncSocketReader(int socket, size_t maxFrameSize=1<<24);
+    /** Returns the socket descriptor **/
+    int getSocket() const { return socket; }
+    /** Returns true if the peer has closed the connection **/
+    bool isClosed() const { return closed; }
+    /** Receive all available data and call handler(Reader &) for every
+        complete frame, returns the number of bytes received. Throws
+        std::system_error on socket errors. **/
+    template <class F>
+    size_t receive(F &&handler) {
+        size_t result=0;
+        for (size_t length; (length=receivePortion());) {
+            decoder.feed(buffer.data(), length, handler);
+            result+=length;
+            if (length<buffer.size())
+                break;
+        }
+        return result;
+    }
+    
+private:
+    size_t receivePortion();
+    
+    int socket;
+    bool closed;
+    FrameDecoder decoder;
+    std::vector<uint8_t> buffer;
+};
+
+}
+
+#endif
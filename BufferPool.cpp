@@ -0,0 +1,112 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Pool of reusable buffers
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include "BufferPool.hpp"
+
+using namespace rohan;
+using std::lock_guard;
+using std::mutex;
+using std::vector;
+
+/******************************************************************************/
+
+/** Returns the number of the smallest class which fits the capacity **/
+static unsigned getClassFor(size_t capacity) {
+    unsigned result=0;
+    while ((BufferPool::MIN_CAPACITY<<result)<capacity)
+        result++;
+    return result;
+}
+
+/** Returns the number of the largest class which the buffer satisfies **/
+static unsigned getClassOf(size_t capacity) {
+    unsigned result=0;
+    while ((BufferPool::MIN_CAPACITY<<(result+1))<=capacity)
+        result++;
+    return result;
+}
+
+BufferPool::BufferPool(size_t maxRetained, size_t maxCapacity) :
+        maxRetained(maxRetained),
+        maxCapacity(std::min(maxCapacity, MIN_CAPACITY<<(CLASSES-1))),
+        retainedBytes(0) {}
+
+vector<uint8_t> BufferPool::acquire(size_t capacity) {
+    capacity=std::max(capacity, MIN_CAPACITY);
+    Shard &shard=getShard();
+    lock_guard<mutex> guard(shard.lock);
+    shard.statistics.acquired++;
+    if (capacity<=maxCapacity) {
+        unsigned index=getClassFor(capacity);
+        vector<vector<uint8_t>> &buffers=shard.buffers[index];
+        if (!buffers.empty()) {
+            vector<uint8_t> result=std::move(buffers.back());
+            buffers.pop_back();
+            shard.retainedBytes-=result.capacity();
+            retainedBytes.fetch_sub(result.capacity(), std::memory_order_relaxed);
+            shard.statistics.hits++;
+            return result;
+        }
+        // Allocate the full class size, so the buffer returns to the class
+        capacity=MIN_CAPACITY<<index;
+    }
+    vector<uint8_t> result;
+    result.reserve(capacity);
+    return result;
+}
+
+void BufferPool::release(vector<uint8_t> &&buffer) {
+    size_t capacity=buffer.capacity();
+    Shard &shard=getShard();
+    lock_guard<mutex> guard(shard.lock);
+    // The limit is shared by the shards, concurrent releases may exceed it a bit
+    if (capacity<MIN_CAPACITY||capacity>maxCapacity||
+            retainedBytes.load(std::memory_order_relaxed)+capacity>maxRetained) {
+        shard.statistics.dropped++;
+        return;
+    }
+    buffer.clear();
+    shard.buffers[getClassOf(capacity)].push_back(std::move(buffer));
+    shard.retainedBytes+=capacity;
+    retainedBytes.fetch_add(capacity, std::memory_order_relaxed);
+    shard.statistics.retained++;
+}
+
+void BufferPool::trim() {
+    for (Shard &shard: shards) {
+        lock_guard<mutex> guard(shard.lock);
+        for (auto &buffers: shard.buffers)
+            buffers.clear();
+        retainedBytes.fetch_sub(shard.retainedBytes, std::memory_order_relaxed);
+        shard.retainedBytes=0;
+    }
+}
+
+BufferPoolStatistics BufferPool::getStatistics() const {
+    BufferPoolStatistics result;
+    for (const Shard &shard: shards) {
+        lock_guard<mutex> guard(shard.lock);
+        result.acquired+=shard.statistics.acquired;
+        result.hits+=shard.statistics.hits;
+        result.retained+=shard.statistics.retained;
+        result.dropped+=shard.statistics.dropped;
+        result.retainedBytes+=shard.retainedBytes;
+    }
+    return result;
+}
+
+BufferPool &BufferPool::getDefault() {
+    static BufferPool pool;
+    return pool;
+}
+
+BufferPool::Shard &BufferPool::getShard() {
+    // Threads are assigned to shards in turn
+    static std::atomic<unsigned> counter {0};
+    thread_local unsigned index=counter++%SHARDS;
+    return shards[index];
+}
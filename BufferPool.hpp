@@ -0,0 +1,94 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Pool of reusable buffers
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_BUFFERPOOL_HPP
+#define __ROHAN_BUFFERPOOL_HPP
+
+#include <atomic>
+#include <mutex>
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** Usage of a buffer pool **/
+struct BufferPoolStatistics {
+    /** Number of acquired buffers **/
+    uint64_t acquired=0;
+    /** Number of buffers acquired from the pool without allocation **/
+    uint64_t hits=0;
+    /** Number of released buffers which were kept in the pool **/
+    uint64_t retained=0;
+    /** Number of released buffers which were freed **/
+    uint64_t dropped=0;
+    /** Memory kept in the pool **/
+    size_t retainedBytes=0;
+    
+    /** Returns the part of requests served without allocation **/
+    double getHitRate() const { return acquired?double(hits)/acquired:0; }
+};
+
+/** Pool of byte arrays grouped by capacity in powers of two. Threads use
+    different shards of the pool, so they seldom wait for each other. **/
+class BufferPool {
+public:
+    /** Smallest capacity of a pooled buffer **/
+    static constexpr size_t MIN_CAPACITY=256;
+    
+    /** Create a pool which keeps up to maxRetained bytes, buffers larger
+        than maxCapacity are never kept **/
+    explicit BufferPool(size_t maxRetained=64<<20, size_t maxCapacity=16<<20);
+    BufferPool(const BufferPool &)=delete;
+    BufferPool &operator =(const BufferPool &)=delete;
+    /** Returns an empty buffer of at least the given capacity **/
+    std::vector<uint8_t> acquire(size_t capacity);
+    /** Return a buffer to the pool **/
+    void release(std::vector<uint8_t> &&buffer);
+    /** Free all kept buffers **/
+    void trim();
+    /** Returns the statistics **/
+    BufferPoolStatistics getStatistics() const;
+    /** Returns the pool shared by the program **/
+    static BufferPool &getDefault();
+    
+private:
+    static const unsigned MIN_BITS=8;
+    static const unsigned CLASSES=32;
+    static const unsigned SHARDS=16;
+    
+    struct alignas(64) Shard {
+        mutable std::mutex lock;
+        std::vector<std::vector<uint8_t>> buffers[CLASSES];
+        size_t retainedBytes=0;
+        BufferPoolStatistics statistics;
+    };
+    
+    Shard &getShard();
+    
+    size_t maxRetained;
+    size_t maxCapacity;
+    /** Memory kept in all the shards **/
+    std::atomic<size_t> retainedBytes;
+    Shard shards[SHARDS];
+};
+
+/** ByteArrayWriter which takes its buffer from a pool and returns it back
+    when destroyed **/
+class PooledByteArrayWriter : public ByteArrayWriter {
+public:
+    /** Create a writer **/
+    explicit PooledByteArrayWriter(BufferPool &pool=BufferPool::getDefault(),
+        size_t capacity=0) : ByteArrayWriter(pool.acquire(capacity)), pool(pool) {}
+    /** Return the buffer to the pool **/
+    ~PooledByteArrayWriter() { pool.release(detach()); }
+    
+private:
+    BufferPool &pool;
+};
+
+}
+
+#endif
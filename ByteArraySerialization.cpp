@@ -8,59 +8,94 @@
 #include <cstring>
 #include "ByteArraySerialization.hpp"
 
-using namespace rohan;
-using std::vector;
+namespace rohan {
 
 /******************************************************************************/
 
-ByteArrayReader::ByteArrayReader(const char * data) :
+ROHAN_INLINE ByteArrayReader::ByteArrayReader(const char * data) :
         data(data), length(strlen(data)), offset(0) {}
 
-ByteArrayReader::ByteArrayReader(const void * data, size_t length) :
+ROHAN_INLINE ByteArrayReader::ByteArrayReader(const void * data, size_t length) :
         data(data), length(length), offset(0) {}
 
-ByteArrayReader::ByteArrayReader(const vector<uint8_t> &buffer,
+ROHAN_INLINE ByteArrayReader::ByteArrayReader(const std::vector<uint8_t> &buffer,
         size_t offset) : data(buffer.data()), length(buffer.size()), offset(offset) {}
 
-size_t ByteArrayReader::read(void * to, size_t length) {
+ROHAN_INLINE size_t ByteArrayReader::read(void * to, size_t length) {
     if (available()<length)
         length=available();
-    memcpy(to, reinterpret_cast<const uint8_t *>(data)+offset, length);
+    if (length)
+        memcpy(to, reinterpret_cast<const uint8_t *>(data)+offset, length);
     offset+=length;
     return length;
 }
 
-size_t ByteArrayReader::skip(size_t length) {
+ROHAN_INLINE size_t ByteArrayReader::skip(size_t length) {
     size_t skipped=available()<length?available():length;
     offset+=skipped;
     return skipped;
 }
 
-size_t ByteArrayReader::available() const {
+ROHAN_INLINE const void * ByteArrayReader::borrow(size_t length) {
+    if (available()<length)
+        return nullptr;
+    const void * result=reinterpret_cast<const uint8_t *>(data)+offset;
+    offset+=length;
+    return result;
+}
+
+ROHAN_INLINE size_t ByteArrayReader::available() const {
     return length-offset;
 }
 
 /******************************************************************************/
 
-static void appendTo(vector<uint8_t> &buffer, const void * from, size_t length) {
+inline void _appendTo(std::vector<uint8_t> &buffer, const void * from, size_t length) {
+    if (!length)
+        return;
     size_t oldSize=buffer.size();
     buffer.resize(oldSize+length);
     memcpy(&buffer[oldSize], from, length);
 }
 
-ByteArrayWriter::ByteArrayWriter(size_t capacity) {
+inline void _appendTo(std::vector<uint8_t> &buffer, const struct iovec * vectors,
+        size_t count) {
+    size_t total=0;
+    for (size_t i=0; i<count; i++)
+        total+=vectors[i].iov_len;
+    buffer.reserve(buffer.size()+total);
+    for (size_t i=0; i<count; i++)
+        _appendTo(buffer, vectors[i].iov_base, vectors[i].iov_len);
+}
+
+ROHAN_INLINE ByteArrayWriter::ByteArrayWriter(size_t capacity) {
     buffer.reserve(capacity);
 }
 
-void ByteArrayWriter::write(const void * from, size_t length) {
-    appendTo(buffer, from, length);
+ROHAN_INLINE ByteArrayWriter::ByteArrayWriter(std::vector<uint8_t> &&buffer) :
+        buffer(std::move(buffer)) {
+    this->buffer.clear();
+}
+
+ROHAN_INLINE void ByteArrayWriter::write(const void * from, size_t length) {
+    _appendTo(buffer, from, length);
+}
+
+ROHAN_INLINE void ByteArrayWriter::writeGather(const struct iovec * vectors, size_t count) {
+    _appendTo(buffer, vectors, count);
 }
 
 /*******************************************************************************/
 
-ByteArrayRefWriter::ByteArrayRefWriter(vector<uint8_t> &buffer) :
+ROHAN_INLINE ByteArrayRefWriter::ByteArrayRefWriter(std::vector<uint8_t> &buffer) :
         buffer(buffer) {}
 
-void ByteArrayRefWriter::write(const void * from, size_t length) {
-    appendTo(buffer, from, length);
+ROHAN_INLINE void ByteArrayRefWriter::write(const void * from, size_t length) {
+    _appendTo(buffer, from, length);
+}
+
+ROHAN_INLINE void ByteArrayRefWriter::writeGather(const struct iovec * vectors, size_t count) {
+    _appendTo(buffer, vectors, count);
+}
+
 }
@@ -29,6 +29,8 @@ public:
     size_t read(void * to, size_t length) override;
     /** Skip a portion of data **/
     size_t skip(size_t length) override;
+    /** Returns a pointer to the next portion of data and skips it **/
+    const void * borrow(size_t length) override;
     /** Returns the number of bytes which are already read **/
     size_t consumed() const { return offset; }
     /** Returns the number of bytes that can be read **/
@@ -45,10 +47,18 @@ class ByteArrayWriter : public Writer {
 public:
     /**/
     explicit ByteArrayWriter(size_t capacity=0);
+    /** Write into the memory of another byte array, its content is discarded **/
+    explicit ByteArrayWriter(std::vector<uint8_t> &&buffer);
     /** Returns the underlying byte array **/
     virtual const std::vector<uint8_t> &getBuffer() const { return buffer; }
+    /** Take the underlying byte array away, the writer becomes empty **/
+    std::vector<uint8_t> detach() { return std::move(buffer); }
+    /** Discard written data keeping the memory **/
+    void clear() { buffer.clear(); }
     /** Write a portion of data **/
     void write(const void * from, size_t length) override;
+    /** Write several portions of data at once **/
+    void writeGather(const struct iovec * vectors, size_t count) override;
     
 private:
     std::vector<uint8_t> buffer;
@@ -63,6 +73,8 @@ public:
     virtual const std::vector<uint8_t> &getBuffer() const { return buffer; }
     /** Write a portion of data **/
     void write(const void * from, size_t length) override;
+    /** Write several portions of data at once **/
+    void writeGather(const struct iovec * vectors, size_t count) override;
     
 private:
     std::vector<uint8_t> &buffer;
@@ -70,4 +82,8 @@ private:
 
 }
 
+#ifdef ROHAN_HEADER_ONLY
+#include "ByteArraySerialization.cpp"
+#endif
+
 #endif
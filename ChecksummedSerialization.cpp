@@ -0,0 +1,238 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Integrity checking of serialized data
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <cstring>
+#include <stdexcept>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#include "ByteArraySerialization.hpp"
+#include "ChecksummedSerialization.hpp"
+
+using namespace rohan;
+
+/******************************************************************************/
+
+namespace {
+
+/** Tables for slicing-by-8 algorithm **/
+class CRCTable {
+public:
+    CRCTable() {
+        const uint32_t POLYNOMIAL=0x82F63B78;
+        for (unsigned i=0; i<256; i++) {
+            uint32_t crc=i;
+            for (unsigned j=0; j<8; j++)
+                crc=(crc>>1)^(POLYNOMIAL&-(crc&1));
+            table[0][i]=crc;
+        }
+        for (unsigned i=0; i<256; i++)
+            for (unsigned j=1; j<8; j++)
+                table[j][i]=(table[j-1][i]>>8)^table[0][table[j-1][i]&0xff];
+    }
+    
+    uint32_t table[8][256];
+};
+
+const CRCTable TABLE;
+
+uint32_t crc32cSoftware(const uint8_t * data, size_t length, uint32_t crc) {
+    const auto &t=TABLE.table;
+    for (; length>=8; data+=8, length-=8) {
+        uint32_t low, high;
+        memcpy(&low, data, 4);
+        memcpy(&high, data+4, 4);
+        low^=crc;
+        crc=t[7][low&0xff]^t[6][(low>>8)&0xff]^t[5][(low>>16)&0xff]^t[4][low>>24]^
+            t[3][high&0xff]^t[2][(high>>8)&0xff]^t[1][(high>>16)&0xff]^t[0][high>>24];
+    }
+    for (; length; length--)
+        crc=(crc>>8)^t[0][(crc^*data++)&0xff];
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(const uint8_t * data, size_t length, uint32_t crc) {
+    uint64_t crc64=crc;
+    for (; length>=8; data+=8, length-=8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc64=_mm_crc32_u64(crc64, value);
+    }
+    crc=crc64;
+    for (; length; length--)
+        crc=_mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+using CRCFunction=uint32_t (*)(const uint8_t *, size_t, uint32_t);
+
+CRCFunction selectImplementation() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2")?crc32cHardware:crc32cSoftware;
+}
+
+const CRCFunction IMPLEMENTATION=selectImplementation();
+#elif defined(__ARM_FEATURE_CRC32)
+uint32_t IMPLEMENTATION(const uint8_t * data, size_t length, uint32_t crc) {
+    for (; length>=8; data+=8, length-=8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc=__crc32cd(crc, value);
+    }
+    for (; length; length--)
+        crc=__crc32cb(crc, *data++);
+    return crc;
+}
+#else
+#define IMPLEMENTATION crc32cSoftware
+#endif
+
+void corrupted() {
+    throw Malformed("checksum mismatch");
+}
+
+}
+
+uint32_t rohan::crc32c(const void * data, size_t length, uint32_t crc) {
+    return ~IMPLEMENTATION(reinterpret_cast<const uint8_t *>(data), length, ~crc);
+}
+
+/******************************************************************************/
+
+ChecksummingWriter::ChecksummingWriter(Writer &sink, size_t blockSize) :
+        sink(sink), blockSize(blockSize) {
+    if (!blockSize)
+        throw std::invalid_argument("blockSize");
+}
+
+ChecksummingWriter::~ChecksummingWriter() {
+    try {
+        flush();
+    }
+    catch (...) {}
+}
+
+void ChecksummingWriter::write(const void * from, size_t length) {
+    const uint8_t * data=reinterpret_cast<const uint8_t *>(from);
+    if (!buffer.empty()) {
+        size_t portion=std::min(length, blockSize-buffer.size());
+        buffer.insert(buffer.end(), data, data+portion);
+        data+=portion;
+        length-=portion;
+        if (buffer.size()<blockSize)
+            return;
+        writeChecksummedBlock(sink, buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    
+    // Large portions are written without copying
+    for (; length>=blockSize; data+=blockSize, length-=blockSize)
+        writeChecksummedBlock(sink, data, blockSize);
+    buffer.insert(buffer.end(), data, data+length);
+}
+
+void ChecksummingWriter::flush() {
+    if (!buffer.empty()) {
+        writeChecksummedBlock(sink, buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    sink.flush();
+}
+
+void rohan::writeChecksummedBlock(Writer &sink, const void * data, size_t length) {
+    ByteArrayWriter header(16);
+    writeVariableInteger(header, length);
+    const std::vector<uint8_t> &prefix=header.getBuffer();
+    uint32_t crc=crc32c(data, length, crc32c(prefix.data(), prefix.size()));
+    uint8_t suffix[4]={uint8_t(crc), uint8_t(crc>>8), uint8_t(crc>>16), uint8_t(crc>>24)};
+    
+    struct iovec vectors[3]={
+        {const_cast<uint8_t *>(prefix.data()), prefix.size()},
+        {const_cast<void *>(data), length},
+        {suffix, sizeof(suffix)}
+    };
+    sink.writeGather(vectors, 3);
+}
+
+/******************************************************************************/
+
+VerifyingReader::VerifyingReader(Reader &source, size_t maxBlockSize) :
+        source(source), maxBlockSize(maxBlockSize), position(0) {}
+
+bool VerifyingReader::end() {
+    while (position==buffer.size())
+        if (!populate())
+            return true;
+    return false;
+}
+
+size_t VerifyingReader::read(void * to, size_t length) {
+    uint8_t * destination=reinterpret_cast<uint8_t *>(to);
+    size_t result=0;
+    while (length) {
+        if (position==buffer.size()) {
+            if (!populate())
+                break;
+            continue;
+        }
+        size_t portion=std::min(length, buffer.size()-position);
+        memcpy(destination, &buffer[position], portion);
+        position+=portion;
+        destination+=portion;
+        length-=portion;
+        result+=portion;
+    }
+    return result;
+}
+
+size_t VerifyingReader::skip(size_t length) {
+    size_t result=0;
+    while (length) {
+        if (position==buffer.size()) {
+            if (!populate())
+                break;
+            continue;
+        }
+        size_t portion=std::min(length, buffer.size()-position);
+        position+=portion;
+        length-=portion;
+        result+=portion;
+    }
+    return result;
+}
+
+bool VerifyingReader::populate() {
+    // The end of the source is allowed only between blocks
+    uint8_t prefix[10];
+    if (!source.read(prefix, 1))
+        return false;
+    size_t nPrefix=1;
+    unsigned long long length=prefix[0]&0x7f;
+    while (prefix[nPrefix-1]&0x80) {
+        if (nPrefix==sizeof(prefix))
+            corrupted();
+        source.readFully(&prefix[nPrefix], 1);
+        length|=(unsigned long long)(prefix[nPrefix]&0x7f)<<(7*nPrefix);
+        nPrefix++;
+    }
+    if (length>maxBlockSize)
+        corrupted();
+    
+    uint8_t suffix[4];
+    buffer.resize(length);
+    source.readFully(buffer.data(), length);
+    source.readFully(suffix, sizeof(suffix));
+    uint32_t expected=suffix[0]|(suffix[1]<<8)|(suffix[2]<<16)|(uint32_t(suffix[3])<<24);
+    if (crc32c(buffer.data(), length, crc32c(prefix, nPrefix))!=expected)
+        corrupted();
+    position=0;
+    return true;
+}
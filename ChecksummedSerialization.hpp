@@ -0,0 +1,74 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Integrity checking of serialized data
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_CHECKSUMMEDSERIALIZATION_HPP
+#define __ROHAN_CHECKSUMMEDSERIALIZATION_HPP
+
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Update CRC32C (Castagnoli) checksum with a portion of data. Uses CPU
+    instructions if they are available. **/
+uint32_t crc32c(const void * data, size_t length, uint32_t crc=0);
+
+/** Write a block: its length, the data and CRC32C of both **/
+void writeChecksummedBlock(Writer &sink, const void * data, size_t length);
+
+/** Writer which splits data into blocks protected by CRC32C **/
+class ChecksummingWriter : public Writer {
+public:
+    /** Default block size **/
+    static const size_t BLOCK_SIZE=65536;
+    
+    /** Create a checksumming writer **/
+    explicit ChecksummingWriter(Writer &sink, size_t blockSize=BLOCK_SIZE);
+    /** Write remaining data. Call flush() explicitly in order to get errors. **/
+    ~ChecksummingWriter();
+    /** Returns the underlying sink **/
+    Writer &getSink() const { return sink; }
+    /** Write a portion of data **/
+    void write(const void * from, size_t length) override;
+    /** Write all buffered data as a block **/
+    void flush() override;
+    
+private:
+    Writer &sink;
+    size_t blockSize;
+    std::vector<uint8_t> buffer;
+};
+
+/** Reader which verifies data written by ChecksummingWriter. Throws
+    Malformed if a block is corrupted. **/
+class VerifyingReader : public Reader {
+public:
+    /** Create a verifying reader, blocks longer than maxBlockSize are
+        considered corrupted **/
+    explicit VerifyingReader(Reader &source, size_t maxBlockSize=1<<24);
+    /** Returns the underlying source **/
+    Reader &getSource() const { return source; }
+    /** Returns true if all data are read, the source may end only between
+        blocks **/
+    bool end();
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    
+private:
+    bool populate();
+    
+    Reader &source;
+    size_t maxBlockSize;
+    size_t position;
+    std::vector<uint8_t> buffer;
+};
+
+}
+
+#endif
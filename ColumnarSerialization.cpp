@@ -0,0 +1,107 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Column-oriented serialization of record vectors
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include "ColumnarSerialization.hpp"
+
+using namespace rohan;
+using std::vector;
+
+/******************************************************************************/
+
+enum ColumnEncoding : uint8_t {
+    PLAIN, DELTA, RUN_LENGTH
+};
+
+static inline uint64_t encodeSigned(uint64_t value) {
+    return _encodeZigzag<int64_t>(value);
+}
+
+static inline uint64_t decodeSigned(uint64_t value) {
+    return _decodeZigzag<int64_t>(value);
+}
+
+void rohan::writeIntegerColumn(Writer &writer, const vector<uint64_t> &values,
+        bool isSigned) {
+    auto plain=[isSigned](uint64_t value) {
+        return isSigned?encodeSigned(value):value;
+    };
+    
+    // Estimate the size with every encoding
+    size_t sizes[3]={0, 0, 0};
+    for (size_t i=0, j; i<values.size(); i=j) {
+        for (j=i+1; j<values.size()&&values[j]==values[i]; j++);
+        sizes[RUN_LENGTH]+=getVariableIntegerSize(plain(values[i]))+
+            getVariableIntegerSize(j-i);
+    }
+    uint64_t previous=0;
+    for (uint64_t value: values) {
+        sizes[PLAIN]+=getVariableIntegerSize(plain(value));
+        sizes[DELTA]+=getVariableIntegerSize(encodeSigned(value-previous));
+        previous=value;
+    }
+    ColumnEncoding encoding=PLAIN;
+    if (sizes[DELTA]<sizes[encoding])
+        encoding=DELTA;
+    if (sizes[RUN_LENGTH]<sizes[encoding])
+        encoding=RUN_LENGTH;
+    
+    writer | uint8_t(encoding);
+    previous=0;
+    switch (encoding) {
+    case PLAIN:
+        for (uint64_t value: values)
+            writeVariableInteger(writer, plain(value));
+        break;
+    case DELTA:
+        for (uint64_t value: values) {
+            writeVariableInteger(writer, encodeSigned(value-previous));
+            previous=value;
+        }
+        break;
+    case RUN_LENGTH:
+        for (size_t i=0, j; i<values.size(); i=j) {
+            for (j=i+1; j<values.size()&&values[j]==values[i]; j++);
+            writeVariableInteger(writer, plain(values[i]));
+            writeVariableInteger(writer, j-i);
+        }
+        break;
+    }
+}
+
+vector<uint64_t> rohan::readIntegerColumn(Reader &reader, size_t count,
+        bool isSigned) {
+    auto plain=[isSigned](uint64_t value) {
+        return isSigned?decodeSigned(value):value;
+    };
+    
+    vector<uint64_t> result;
+    uint64_t previous=0;
+    switch (uint8_t(reader)) {
+    case PLAIN:
+        while (result.size()<count)
+            result.push_back(plain(readVariableInteger(reader)));
+        break;
+    case DELTA:
+        while (result.size()<count) {
+            previous+=decodeSigned(readVariableInteger(reader));
+            result.push_back(previous);
+        }
+        break;
+    case RUN_LENGTH:
+        while (result.size()<count) {
+            uint64_t value=plain(readVariableInteger(reader));
+            size_t run=readVariableInteger(reader);
+            if (!run||run>count-result.size())
+                throw Malformed("malformed run length");
+            result.insert(result.end(), run, value);
+        }
+        break;
+    default:
+        throw Malformed("unknown column encoding");
+    }
+    return result;
+}
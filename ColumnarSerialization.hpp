@@ -0,0 +1,160 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Column-oriented serialization of record vectors
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_COLUMNARSERIALIZATION_HPP
+#define __ROHAN_COLUMNARSERIALIZATION_HPP
+
+#include <tuple>
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** Write integers (signed ones are sign-extended) as a column. Plain,
+    delta or run-length encoding is chosen, whichever is shorter. **/
+void writeIntegerColumn(Writer &writer, const std::vector<uint64_t> &values,
+        bool isSigned);
+
+/** Read a column written by writeIntegerColumn() **/
+std::vector<uint64_t> readIntegerColumn(Reader &reader, size_t count,
+        bool isSigned);
+
+/** Serializes vectors of records field by field: values of every field are
+    stored as a separate column prefixed with its size, so that unneeded
+    columns are skipped without decoding. Integer columns are delta or
+    run-length encoded. String dictionary and shared objects tables do not
+    apply to the columns. **/
+template <class T, class... F>
+class Columns {
+public:
+    /** Type of the field number I **/
+    template <size_t I>
+    using FieldType=std::tuple_element_t<I, std::tuple<F...>>;
+    
+    /** Initialize with pointers to fields of the record **/
+    explicit Columns(F T::*... fields) : fields(fields...) {}
+    /** Write a vector of records **/
+    void write(Writer &writer, const std::vector<T> &records) const {
+        writeVariableInteger(writer, records.size());
+        writeVariableInteger(writer, sizeof...(F));
+        writeColumns(writer, records, std::index_sequence_for<F...>());
+    }
+    /** Read a vector of records. Records are default-constructed and then
+        fields are assigned, or brace-initialized with all the fields if T
+        is not default-constructible. **/
+    std::vector<T> read(Reader &reader) const {
+        return readRecords(reader, std::index_sequence_for<F...>());
+    }
+    /** Read values of a single field, other columns are skipped **/
+    template <size_t I>
+    std::vector<FieldType<I>> readColumn(Reader &reader) const {
+        size_t count=readLength(reader);
+        size_t nColumns=readColumnCount(reader);
+        for (size_t i=0; i<I; i++)
+            reader.skipFully(readVariableInteger(reader));
+        auto result=decodeColumn<FieldType<I>>(reader, count);
+        for (size_t i=I+1; i<nColumns; i++)
+            reader.skipFully(readVariableInteger(reader));
+        return result;
+    }
+    
+private:
+    template <class V>
+    static constexpr bool isInteger=std::is_integral_v<V>&&!std::is_same_v<V, bool>;
+    
+    template <size_t... I>
+    void writeColumns(Writer &writer, const std::vector<T> &records,
+            std::index_sequence<I...>) const {
+        (writeColumn(writer, records, std::get<I>(fields)), ...);
+    }
+    
+    template <class V>
+    static void writeColumn(Writer &writer, const std::vector<T> &records,
+            V T::*field) {
+        ByteArrayWriter column;
+        if constexpr (isInteger<V>) {
+            std::vector<uint64_t> values(records.size());
+            for (size_t i=0; i<records.size(); i++)
+                values[i]=static_cast<uint64_t>(records[i].*field);
+            writeIntegerColumn(column, values, std::is_signed_v<V>);
+        }
+        else {
+            for (const T &record: records)
+                column | record.*field;
+        }
+        const std::vector<uint8_t> &data=column.getBuffer();
+        writeVariableInteger(writer, data.size());
+        writer.write(data.data(), data.size());
+    }
+    
+    size_t readColumnCount(Reader &reader) const {
+        size_t result=readLength(reader);
+        if (result<sizeof...(F))
+            throw Malformed("missing columns");
+        return result;
+    }
+    
+    template <class V>
+    static std::vector<V> decodeColumn(Reader &reader, size_t count) {
+        // Columns are written by a separate writer without the dictionary
+        size_t size=readLength(reader);
+        std::vector<uint8_t> copy;
+        const void * data=reader.borrow(size);
+        if (!data) {
+            readPaged(reader, copy, size);
+            data=copy.data();
+        }
+        ByteArrayReader column(data, size);
+        column.setLimits(reader.getLimits());
+        
+        std::vector<V> result;
+        if constexpr (isInteger<V>) {
+            std::vector<uint64_t> values=readIntegerColumn(column, count,
+                std::is_signed_v<V>);
+            result.reserve(count);
+            for (uint64_t value: values)
+                result.push_back(static_cast<V>(value));
+        }
+        else {
+            for (size_t i=0; i<count; i++)
+                result.push_back(V(column));
+        }
+        return result;
+    }
+    
+    template <size_t... I>
+    std::vector<T> readRecords(Reader &reader, std::index_sequence<I...>) const {
+        size_t count=readLength(reader);
+        size_t nColumns=readColumnCount(reader);
+        std::tuple<std::vector<F>...> values{decodeColumn<F>(reader, ((void)I, count))...};
+        for (size_t i=sizeof...(F); i<nColumns; i++)
+            reader.skipFully(readVariableInteger(reader));
+        
+        std::vector<T> result;
+        result.reserve(count);
+        for (size_t i=0; i<count; i++) {
+            if constexpr (std::is_default_constructible_v<T>) {
+                T &record=result.emplace_back();
+                ((record.*std::get<I>(fields)=std::move(std::get<I>(values)[i])), ...);
+            }
+            else
+                result.push_back(T{std::move(std::get<I>(values)[i])...});
+        }
+        return result;
+    }
+    
+    std::tuple<F T::*...> fields;
+};
+
+/** Create a column description of a record type **/
+template <class T, class... F>
+inline Columns<T, F...> columns(F T::*... fields) {
+    return Columns<T, F...>(fields...);
+}
+
+}
+
+#endif
@@ -0,0 +1,324 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Block compression of serialized data
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <cstring>
+#include <stdexcept>
+#include "ByteArraySerialization.hpp"
+#include "CompressedSerialization.hpp"
+#include "ParallelSerialization.hpp"
+
+using namespace rohan;
+using std::vector;
+
+/******************************************************************************/
+
+static const size_t MIN_MATCH=4;
+static const size_t LAST_LITERALS=5;
+static const size_t MAX_OFFSET=65535;
+static const unsigned HASH_BITS=14;
+
+static void corrupted() {
+    throw Malformed("corrupted compressed block");
+}
+
+static inline uint32_t read32(const uint8_t * data) {
+    uint32_t result;
+    memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+static inline uint32_t hash(uint32_t sequence) {
+    return (sequence*2654435761u)>>(32-HASH_BITS);
+}
+
+static uint8_t * putLength(uint8_t * out, size_t length) {
+    for (; length>=255; length-=255)
+        *out++=255;
+    *out++=length;
+    return out;
+}
+
+/** Emit literals followed by a match, matchLength=0 ends the block **/
+static uint8_t * putSequence(uint8_t * out, const uint8_t * literals,
+        size_t nLiterals, size_t offset, size_t matchLength) {
+    uint8_t * token=out++;
+    *token=(nLiterals<15?nLiterals:15)<<4;
+    if (nLiterals>=15)
+        out=putLength(out, nLiterals-15);
+    memcpy(out, literals, nLiterals);
+    out+=nLiterals;
+    if (matchLength) {
+        size_t extra=matchLength-MIN_MATCH;
+        *out++=offset;
+        *out++=offset>>8;
+        *token|=extra<15?extra:15;
+        if (extra>=15)
+            out=putLength(out, extra-15);
+    }
+    return out;
+}
+
+size_t rohan::getCompressBound(size_t length) {
+    return length+length/255+16;
+}
+
+size_t rohan::compressBlock(const void * from, size_t length, void * to,
+        int level) {
+    const uint8_t * source=reinterpret_cast<const uint8_t *>(from);
+    uint8_t * out=reinterpret_cast<uint8_t *>(to);
+    size_t anchor=0;
+    
+    if (level>0&&length>MIN_MATCH+LAST_LITERALS) {
+        // Positions are stored plus one, so zero means "no position"
+        vector<uint32_t> table(1<<HASH_BITS, 0), chain;
+        unsigned depth=1;
+        if (level>1) {
+            chain.resize(length);
+            depth=1u<<(level<9?level-1:8);
+        }
+        size_t limit=length-LAST_LITERALS;
+        
+        for (size_t position=0; position+MIN_MATCH<=limit;) {
+            uint32_t sequence=read32(source+position);
+            uint32_t h=hash(sequence);
+            size_t bestLength=0, bestPosition=0;
+            uint32_t candidate=table[h];
+            for (unsigned i=0; candidate&&i<depth; i++) {
+                size_t match=candidate-1;
+                if (position-match>MAX_OFFSET)
+                    break;
+                if (read32(source+match)==sequence) {
+                    size_t matchLength=MIN_MATCH;
+                    while (position+matchLength<limit&&
+                            source[match+matchLength]==source[position+matchLength])
+                        matchLength++;
+                    if (matchLength>bestLength) {
+                        bestLength=matchLength;
+                        bestPosition=match;
+                    }
+                }
+                candidate=chain.empty()?0:chain[match];
+            }
+            if (!chain.empty())
+                chain[position]=table[h];
+            table[h]=position+1;
+            
+            if (bestLength) {
+                out=putSequence(out, source+anchor, position-anchor,
+                        position-bestPosition, bestLength);
+                if (!chain.empty()) {
+                    // Index the positions inside of the match
+                    for (size_t p=position+1; p<position+bestLength&&p+MIN_MATCH<=limit; p++) {
+                        uint32_t hp=hash(read32(source+p));
+                        chain[p]=table[hp];
+                        table[hp]=p+1;
+                    }
+                }
+                position+=bestLength;
+                anchor=position;
+            }
+            else {
+                // Speed up on incompressible data
+                position+=1+((position-anchor)>>6);
+            }
+        }
+    }
+    
+    out=putSequence(out, source+anchor, length-anchor, 0, 0);
+    return out-reinterpret_cast<uint8_t *>(to);
+}
+
+size_t rohan::decompressBlock(const void * from, size_t length, void * to,
+        size_t capacity) {
+    const uint8_t * in=reinterpret_cast<const uint8_t *>(from);
+    const uint8_t * end=in+length;
+    uint8_t * const start=reinterpret_cast<uint8_t *>(to);
+    uint8_t * out=start;
+    uint8_t * const limit=start+capacity;
+    
+    auto getLength=[&](size_t length) {
+        if (length==15) {
+            uint8_t byte;
+            do {
+                if (in>=end)
+                    corrupted();
+                byte=*in++;
+                length+=byte;
+            } while (byte==255);
+        }
+        return length;
+    };
+    
+    while (in<end) {
+        uint8_t token=*in++;
+        size_t nLiterals=getLength(token>>4);
+        if (size_t(end-in)<nLiterals||size_t(limit-out)<nLiterals)
+            corrupted();
+        if (nLiterals)
+            memcpy(out, in, nLiterals);
+        out+=nLiterals;
+        in+=nLiterals;
+        if (in==end)
+            break;
+        
+        if (end-in<2)
+            corrupted();
+        size_t offset=in[0]|(in[1]<<8);
+        in+=2;
+        size_t matchLength=getLength(token&15)+MIN_MATCH;
+        if (!offset||offset>size_t(out-start)||size_t(limit-out)<matchLength)
+            corrupted();
+        const uint8_t * match=out-offset;
+        if (offset>=matchLength)
+            memcpy(out, match, matchLength);
+        else {
+            // Overlapping match repeats the last offset bytes
+            for (size_t i=0; i<matchLength; i++)
+                out[i]=match[i];
+        }
+        out+=matchLength;
+    }
+    
+    return out-start;
+}
+
+/******************************************************************************/
+
+CompressingWriter::CompressingWriter(Writer &sink, int level, size_t blockSize,
+        unsigned nThreads) : sink(sink), level(level), blockSize(blockSize),
+        nThreads(nThreads?nThreads:getDefaultThreadCount()) {
+    if (!blockSize)
+        throw std::invalid_argument("blockSize");
+    buffer.reserve(blockSize*this->nThreads);
+}
+
+CompressingWriter::~CompressingWriter() {
+    try {
+        flush();
+    }
+    catch (...) {}
+}
+
+void CompressingWriter::write(const void * from, size_t length) {
+    const uint8_t * data=reinterpret_cast<const uint8_t *>(from);
+    size_t capacity=blockSize*nThreads;
+    while (length) {
+        size_t portion=std::min(length, capacity-buffer.size());
+        buffer.insert(buffer.end(), data, data+portion);
+        data+=portion;
+        length-=portion;
+        if (buffer.size()==capacity)
+            compress();
+    }
+}
+
+void CompressingWriter::flush() {
+    if (!buffer.empty())
+        compress();
+    sink.flush();
+}
+
+void CompressingWriter::compress() {
+    size_t nBlocks=(buffer.size()+blockSize-1)/blockSize;
+    vector<vector<uint8_t>> blocks(nBlocks);
+    runParallel(nBlocks, nThreads, [&](size_t index) {
+        size_t offset=index*blockSize;
+        size_t length=std::min(blockSize, buffer.size()-offset);
+        const uint8_t * data=&buffer[offset];
+        vector<uint8_t> packed(getCompressBound(length));
+        size_t stored=compressBlock(data, length, packed.data(), level);
+        
+        // Keep the block uncompressed if compression does not help
+        ByteArrayRefWriter block(blocks[index]);
+        writeVariableInteger(block, length);
+        if (stored<length) {
+            writeVariableInteger(block, stored);
+            block.write(packed.data(), stored);
+        }
+        else {
+            writeVariableInteger(block, length);
+            block.write(data, length);
+        }
+    });
+    
+    vector<struct iovec> vectors(nBlocks);
+    for (size_t i=0; i<nBlocks; i++) {
+        vectors[i].iov_base=blocks[i].data();
+        vectors[i].iov_len=blocks[i].size();
+    }
+    sink.writeGather(vectors.data(), vectors.size());
+    buffer.clear();
+}
+
+/******************************************************************************/
+
+DecompressingReader::DecompressingReader(Reader &source, size_t maxBlockSize) :
+        source(source), maxBlockSize(maxBlockSize), position(0) {}
+
+size_t DecompressingReader::read(void * to, size_t length) {
+    uint8_t * destination=reinterpret_cast<uint8_t *>(to);
+    size_t result=0;
+    while (length) {
+        if (position==buffer.size()) {
+            if (!populate())
+                break;
+            continue;
+        }
+        size_t portion=std::min(length, buffer.size()-position);
+        memcpy(destination, &buffer[position], portion);
+        position+=portion;
+        destination+=portion;
+        length-=portion;
+        result+=portion;
+    }
+    return result;
+}
+
+size_t DecompressingReader::skip(size_t length) {
+    size_t result=0;
+    while (length) {
+        if (position==buffer.size()) {
+            if (!populate())
+                break;
+            continue;
+        }
+        size_t portion=std::min(length, buffer.size()-position);
+        position+=portion;
+        length-=portion;
+        result+=portion;
+    }
+    return result;
+}
+
+bool DecompressingReader::populate() {
+    // The end of the source is allowed only between blocks
+    uint8_t byte;
+    if (!source.read(&byte, 1))
+        return false;
+    unsigned long long length=byte&0x7f;
+    for (unsigned shift=7; byte&0x80; shift+=7) {
+        if (shift>=64)
+            corrupted();
+        byte=uint8_t(source);
+        length|=(unsigned long long)(byte&0x7f)<<shift;
+    }
+    unsigned long long stored=readVariableInteger(source);
+    if (length>maxBlockSize||stored>getCompressBound(length))
+        corrupted();
+    
+    buffer.resize(length);
+    if (stored==length)
+        source.readFully(buffer.data(), length);
+    else {
+        compressed.resize(stored);
+        source.readFully(compressed.data(), stored);
+        if (length!=decompressBlock(compressed.data(), stored, buffer.data(), length))
+            corrupted();
+    }
+    position=0;
+    return true;
+}
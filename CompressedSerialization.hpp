@@ -0,0 +1,84 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Block compression of serialized data
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_COMPRESSEDSERIALIZATION_HPP
+#define __ROHAN_COMPRESSEDSERIALIZATION_HPP
+
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Returns the maximal size of compressed data for the given input size **/
+size_t getCompressBound(size_t length);
+
+/** Compress a block with LZ77 algorithm (LZ4-style sequences). Level 0 stores
+    data as literals, 1 is the fastest, higher levels search deeper. Returns
+    the size of compressed data. **/
+size_t compressBlock(const void * from, size_t length, void * to, int level=1);
+
+/** Decompress a block, returns the size of decompressed data.
+    Throws Malformed if the block is corrupted. **/
+size_t decompressBlock(const void * from, size_t length, void * to,
+        size_t capacity);
+
+/** Writer which compresses data in blocks before passing them to the sink **/
+class CompressingWriter : public Writer {
+public:
+    /** Default block size **/
+    static const size_t BLOCK_SIZE=65536;
+    
+    /** Create a compressing writer, nThreads blocks are compressed at once
+        (0 means hardware concurrency) **/
+    explicit CompressingWriter(Writer &sink, int level=1,
+            size_t blockSize=BLOCK_SIZE, unsigned nThreads=1);
+    /** Compress and write remaining data. Call flush() explicitly in order
+        to get errors. **/
+    ~CompressingWriter();
+    /** Returns the underlying sink **/
+    Writer &getSink() const { return sink; }
+    /** Write a portion of data **/
+    void write(const void * from, size_t length) override;
+    /** Compress and write all buffered data **/
+    void flush() override;
+    
+private:
+    void compress();
+    
+    Writer &sink;
+    int level;
+    size_t blockSize;
+    unsigned nThreads;
+    std::vector<uint8_t> buffer;
+};
+
+/** Reader which decompresses data written by CompressingWriter **/
+class DecompressingReader : public Reader {
+public:
+    /** Create a decompressing reader, blocks longer than maxBlockSize are
+        considered corrupted **/
+    explicit DecompressingReader(Reader &source, size_t maxBlockSize=1<<24);
+    /** Returns the underlying source **/
+    Reader &getSource() const { return source; }
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    
+private:
+    bool populate();
+    
+    Reader &source;
+    size_t maxBlockSize;
+    size_t position;
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> compressed;
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Readers and writers which count calls, bytes and time
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <chrono>
+#include "CountingSerialization.hpp"
+
+using namespace rohan;
+using std::chrono::steady_clock;
+
+/******************************************************************************/
+
+namespace {
+
+/** Adds time spent in a scope to the statistics **/
+class IOTimer {
+public:
+    IOTimer(IOStatistics &statistics, bool timed) : statistics(timed?&statistics:nullptr) {
+        if (timed)
+            start=steady_clock::now();
+    }
+    ~IOTimer() {
+        if (statistics)
+            statistics->nanoseconds+=std::chrono::duration_cast<std::chrono::nanoseconds>(
+                steady_clock::now()-start).count();
+    }
+    
+private:
+    IOStatistics * statistics;
+    steady_clock::time_point start;
+};
+
+}
+
+/******************************************************************************/
+
+CountingReader::CountingReader(Reader &source, bool timed) :
+        source(source), timed(timed) {}
+
+size_t CountingReader::read(void * to, size_t length) {
+    IOTimer timer(statistics, timed);
+    statistics.calls++;
+    size_t result=source.read(to, length);
+    statistics.bytes+=result;
+    return result;
+}
+
+size_t CountingReader::skip(size_t length) {
+    IOTimer timer(statistics, timed);
+    statistics.calls++;
+    size_t result=source.skip(length);
+    statistics.skipped+=result;
+    return result;
+}
+
+const void * CountingReader::borrow(size_t length) {
+    IOTimer timer(statistics, timed);
+    statistics.calls++;
+    const void * result=source.borrow(length);
+    if (result)
+        statistics.bytes+=length;
+    return result;
+}
+
+/******************************************************************************/
+
+CountingWriter::CountingWriter(Writer &sink, bool timed) :
+        sink(sink), timed(timed) {}
+
+void CountingWriter::write(const void * from, size_t length) {
+    IOTimer timer(statistics, timed);
+    statistics.calls++;
+    sink.write(from, length);
+    statistics.bytes+=length;
+}
+
+void CountingWriter::writeGather(const struct iovec * vectors, size_t count) {
+    IOTimer timer(statistics, timed);
+    statistics.calls++;
+    sink.writeGather(vectors, count);
+    for (size_t i=0; i<count; i++)
+        statistics.bytes+=vectors[i].iov_len;
+}
+
+void CountingWriter::flush() {
+    IOTimer timer(statistics, timed);
+    statistics.calls++;
+    sink.flush();
+}
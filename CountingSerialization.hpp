@@ -0,0 +1,78 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Readers and writers which count calls, bytes and time
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_COUNTINGSERIALIZATION_HPP
+#define __ROHAN_COUNTINGSERIALIZATION_HPP
+
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Calls to a source or a sink and data passed through them **/
+struct IOStatistics {
+    /** Number of calls **/
+    uint64_t calls=0;
+    /** Number of bytes read or written **/
+    uint64_t bytes=0;
+    /** Number of bytes skipped **/
+    uint64_t skipped=0;
+    /** Time spent in the underlying stream if timing is on **/
+    uint64_t nanoseconds=0;
+};
+
+/** Reader which counts calls to the source and bytes read from it **/
+class CountingReader : public Reader {
+public:
+    /** Create a counting reader, timing costs two clock reads per call **/
+    explicit CountingReader(Reader &source, bool timed=false);
+    /** Returns the underlying stream **/
+    Reader &getSource() const { return source; }
+    /** Returns the statistics **/
+    const IOStatistics &getStatistics() const { return statistics; }
+    /** Reset the statistics **/
+    void reset() { statistics=IOStatistics(); }
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    /** Borrow a portion of data from the source **/
+    const void * borrow(size_t length) override;
+    
+private:
+    Reader &source;
+    bool timed;
+    IOStatistics statistics;
+};
+
+/** Writer which counts calls to the sink and bytes written to it **/
+class CountingWriter : public Writer {
+public:
+    /** Create a counting writer, timing costs two clock reads per call **/
+    explicit CountingWriter(Writer &sink, bool timed=false);
+    /** Returns the underlying stream **/
+    Writer &getSink() const { return sink; }
+    /** Returns the statistics **/
+    const IOStatistics &getStatistics() const { return statistics; }
+    /** Reset the statistics **/
+    void reset() { statistics=IOStatistics(); }
+    /** Write a portion of data **/
+    void write(const void * from, size_t length) override;
+    /** Write several portions of data at once **/
+    void writeGather(const struct iovec * vectors, size_t count) override;
+    /** Flush the sink **/
+    void flush() override;
+    
+private:
+    Writer &sink;
+    bool timed;
+    IOStatistics statistics;
+};
+
+}
+
+#endif
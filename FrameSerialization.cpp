@@ -0,0 +1,41 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Length-delimited frames and their incremental decoding
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include "FrameSerialization.hpp"
+
+using namespace rohan;
+
+/******************************************************************************/
+
+FrameDecoder::FrameDecoder(size_t maxFrameSize) : maxFrameSize(maxFrameSize),
+        frameLength(0), shift(0), payload(false) {}
+
+bool FrameDecoder::parseLength(const uint8_t *&data, size_t &length) {
+    while (length) {
+        uint8_t byte=*data++;
+        length--;
+        if (shift>=8*sizeof(frameLength))
+            throw Malformed("malformed frame length");
+        frameLength|=size_t(byte&0x7f)<<shift;
+        shift+=7;
+        if (!(byte&0x80)) {
+            if (frameLength>maxFrameSize)
+                throw Malformed("frame is too long");
+            payload=true;
+            shift=0;
+            partial.clear();
+            return true;
+        }
+    }
+    return false;
+}
+
+void FrameDecoder::reset() {
+    frameLength=0;
+    shift=0;
+    payload=false;
+}
@@ -0,0 +1,90 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Length-delimited frames and their incremental decoding
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_FRAMESERIALIZATION_HPP
+#define __ROHAN_FRAMESERIALIZATION_HPP
+
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** Write a value as a frame: its length followed by the value itself **/
+template <class T>
+void writeFrame(Writer &writer, const T &value) {
+    ByteArrayWriter frame;
+    frame | value;
+    const std::vector<uint8_t> &data=frame.getBuffer();
+    writeVariableInteger(writer, data.size());
+    writer.write(data.data(), data.size());
+}
+
+/** Decoder which is fed with portions of data as they arrive and passes
+    every complete frame to the handler. Data are never parsed twice, and
+    frames which arrive in one portion are decoded without copying. **/
+class FrameDecoder {
+public:
+    /** Create a decoder, longer frames are considered malformed **/
+    explicit FrameDecoder(size_t maxFrameSize=1<<24);
+    /** Returns true if there is no incomplete frame **/
+    bool empty() const { return !payload&&!shift; }
+    /** Returns the number of bytes of the current frame which are received **/
+    size_t buffered() const { return payload?partial.size():0; }
+    /** Feed a portion of data, handler(Reader &) is called for every complete
+        frame. Returns the number of frames. **/
+    template <class F>
+    size_t feed(const void * from, size_t length, F &&handler) {
+        const uint8_t * data=reinterpret_cast<const uint8_t *>(from);
+        size_t nFrames=0;
+        while (length) {
+            if (!payload) {
+                if (!parseLength(data, length))
+                    break;
+                if (frameLength)
+                    continue;
+            }
+            else if (partial.empty()&&length>=frameLength) {
+                // Whole frame is here
+                ByteArrayReader reader(data, frameLength);
+                data+=frameLength;
+                length-=frameLength;
+                reset();
+                handler(static_cast<Reader &>(reader));
+                nFrames++;
+                continue;
+            }
+            else {
+                size_t portion=std::min(length, frameLength-partial.size());
+                partial.insert(partial.end(), data, data+portion);
+                data+=portion;
+                length-=portion;
+                if (partial.size()<frameLength)
+                    break;
+            }
+            
+            // Complete frame in the buffer (or an empty frame)
+            ByteArrayReader reader(partial.data(), frameLength);
+            reset();
+            handler(static_cast<Reader &>(reader));
+            nFrames++;
+        }
+        return nFrames;
+    }
+    
+private:
+    bool parseLength(const uint8_t *&data, size_t &length);
+    void reset();
+    
+    size_t maxFrameSize;
+    size_t frameLength;
+    unsigned shift;
+    bool payload;
+    std::vector<uint8_t> partial;
+};
+
+}
+
+#endif
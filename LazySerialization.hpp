@@ -0,0 +1,86 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Deferred deserialization of values
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_LAZYSERIALIZATION_HPP
+#define __ROHAN_LAZYSERIALIZATION_HPP
+
+#include <optional>
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** Value which is written with its length and decoded on the first access.
+    If the reader keeps data in memory (like ByteArrayReader), the encoded
+    value is not copied, so the data must outlive the object. Limits of the
+    reader apply to decoding of the value. A value which was never accessed
+    is written back without decoding. String dictionary
+    and shared objects tables do not apply to the value. **/
+template <class T>
+class Lazy {
+public:
+    /** Initialize with a value **/
+    Lazy(const T &value) : value(value), data(nullptr), length(0) {}
+    /** Initialize with a value **/
+    Lazy(T &&value) : value(std::move(value)), data(nullptr), length(0) {}
+    /** Read the encoded value **/
+    explicit Lazy(Reader &reader) : length(readLength(reader)),
+            limits(reader.getLimits()) {
+        data=reinterpret_cast<const uint8_t *>(reader.borrow(length));
+        if (!data) {
+            auto copy=std::make_shared<std::vector<uint8_t>>();
+            readPaged(reader, *copy, length);
+            data=copy->data();
+            storage=copy;
+        }
+    }
+    /** Returns true if the value is already decoded **/
+    bool isDecoded() const { return value.has_value(); }
+    /** Returns the length of the encoded value, if it was read **/
+    size_t getEncodedLength() const { return length; }
+    /** Returns the value, decodes it if necessary **/
+    const T &get() const {
+        if (!value) {
+            ByteArrayReader reader(data, length);
+            reader.setLimits(limits);
+            value.emplace(T(reader));
+        }
+        return *value;
+    }
+    /** Returns the value for modification **/
+    T &get() {
+        return const_cast<T &>(static_cast<const Lazy *>(this)->get());
+    }
+    /** Returns the value **/
+    const T &operator *() const { return get(); }
+    /** Access the value **/
+    const T * operator ->() const { return &get(); }
+    /** Write the value **/
+    void serialize(Writer &writer) const {
+        if (value) {
+            ByteArrayWriter encoded;
+            encoded | *value;
+            const std::vector<uint8_t> &buffer=encoded.getBuffer();
+            writeVariableInteger(writer, buffer.size());
+            writer.write(buffer.data(), buffer.size());
+        }
+        else {
+            writeVariableInteger(writer, length);
+            writer.write(data, length);
+        }
+    }
+    
+private:
+    mutable std::optional<T> value;
+    const uint8_t * data;
+    size_t length;
+    Limits limits;
+    std::shared_ptr<const std::vector<uint8_t>> storage;
+};
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Reader with a limit of data size
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <algorithm>
+#include "LimitedReader.hpp"
+
+using namespace rohan;
+
+/******************************************************************************/
+
+LimitedReader::LimitedReader(Reader &source, size_t maxBytes) :
+        source(source), maxBytes(maxBytes), offset(0) {}
+
+static void exceeded() {
+    throw Malformed("data size exceeds the limit");
+}
+
+size_t LimitedReader::read(void * to, size_t length) {
+    size_t portion=std::min(length, remaining());
+    if (length&&!portion) {
+        // The end of the source at the limit is not an error
+        if (source.read(to, 1))
+            exceeded();
+        return 0;
+    }
+    size_t result=source.read(to, portion);
+    offset+=result;
+    return result;
+}
+
+void LimitedReader::readFully(void * to, size_t length) {
+    if (length>remaining())
+        exceeded();
+    Reader::readFully(to, length);
+}
+
+size_t LimitedReader::skip(size_t length) {
+    size_t portion=std::min(length, remaining());
+    if (length&&!portion) {
+        if (source.skip(1))
+            exceeded();
+        return 0;
+    }
+    size_t result=source.skip(portion);
+    offset+=result;
+    return result;
+}
+
+const void * LimitedReader::borrow(size_t length) {
+    if (length>remaining())
+        return nullptr;
+    const void * result=source.borrow(length);
+    if (result)
+        offset+=length;
+    return result;
+}
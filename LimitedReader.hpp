@@ -0,0 +1,47 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Reader with a limit of data size
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_LIMITEDREADER_HPP
+#define __ROHAN_LIMITEDREADER_HPP
+
+#include "Reader.hpp"
+
+namespace rohan {
+
+/** Reader which throws Malformed if the source has more than maxBytes and
+    they are needed. Larger requests of read() and skip() are cut to the
+    remaining bytes, so buffering readers on top of it work. Use it to bound
+    resources spent on untrusted data. **/
+class LimitedReader : public Reader {
+public:
+    /** Create a limited reader **/
+    LimitedReader(Reader &source, size_t maxBytes);
+    /** Returns the underlying stream **/
+    Reader &getSource() const { return source; }
+    /** Returns the number of bytes which are already read or skipped **/
+    size_t consumed() const { return offset; }
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Read a portion of data, throws Malformed if it exceeds the limit **/
+    void readFully(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    /** Borrow a portion of data from the source, nullptr if it exceeds the
+        limit **/
+    const void * borrow(size_t length) override;
+    
+private:
+    size_t remaining() const { return maxBytes-offset; }
+    
+    Reader &source;
+    size_t maxBytes;
+    size_t offset;
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Parallel serialization of large containers
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "ParallelSerialization.hpp"
+
+using namespace rohan;
+using std::function;
+
+/******************************************************************************/
+
+unsigned rohan::getDefaultThreadCount() {
+    unsigned result=std::thread::hardware_concurrency();
+    return result?result:1;
+}
+
+void rohan::runParallel(size_t nTasks, unsigned nThreads,
+        const function<void(size_t)> &task) {
+    if (!nThreads)
+        nThreads=getDefaultThreadCount();
+    if (nThreads>nTasks)
+        nThreads=nTasks;
+    
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorLock;
+    auto worker=[&]() {
+        for (size_t index; (index=next++)<nTasks;) {
+            try {
+                task(index);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(errorLock);
+                if (!error)
+                    error=std::current_exception();
+                next=nTasks;
+            }
+        }
+    };
+    
+    // The calling thread works too
+    std::vector<std::thread> threads;
+    for (unsigned i=1; i<nThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread: threads)
+        thread.join();
+    
+    if (error)
+        std::rethrow_exception(error);
+}
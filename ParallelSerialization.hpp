@@ -0,0 +1,84 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Parallel serialization of large containers
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_PARALLELSERIALIZATION_HPP
+#define __ROHAN_PARALLELSERIALIZATION_HPP
+
+#include <functional>
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** Run nTasks tasks on nThreads threads (0 means hardware concurrency) and
+    rethrow the first exception thrown by any of the tasks **/
+void runParallel(size_t nTasks, unsigned nThreads,
+        const std::function<void(size_t)> &task);
+
+/** Returns the number of threads to use if 0 threads were requested **/
+unsigned getDefaultThreadCount();
+
+/** Serializes a vector on several threads. Each chunk of the vector is
+    serialized into its own buffer, then the buffers are written in order,
+    so data format is the same as for the plain std::vector. The vector is
+    written sequentially if the writer has a string dictionary or a shared
+    objects table, because they depend on the order of writing. **/
+template <class T>
+class Parallel {
+public:
+    /** Minimal number of elements which is worth splitting **/
+    static const size_t THRESHOLD=4096;
+    
+    /** Initialize with a reference to the vector **/
+    explicit Parallel(const std::vector<T> &vector, unsigned nThreads=0,
+            size_t chunkSize=0) : vector(vector), nThreads(nThreads),
+            chunkSize(chunkSize) {}
+    /** Write the vector **/
+    void serialize(Writer &writer) const {
+        size_t length=vector.size();
+        unsigned threads=nThreads?nThreads:getDefaultThreadCount();
+        if (threads<2||length<THRESHOLD||writer.getDictionary()||writer.getReferences()) {
+            writer | vector;
+            return;
+        }
+        
+        // Several chunks per thread to balance uneven elements
+        size_t chunk=chunkSize?chunkSize:(length+4*threads-1)/(4*threads);
+        size_t nChunks=(length+chunk-1)/chunk;
+        std::vector<ByteArrayWriter> buffers(nChunks);
+        runParallel(nChunks, threads, [&](size_t index) {
+            size_t end=std::min(length, (index+1)*chunk);
+            ByteArrayWriter &buffer=buffers[index];
+            for (size_t i=index*chunk; i<end; i++)
+                buffer | vector[i];
+        });
+        
+        std::vector<struct iovec> vectors(nChunks);
+        for (size_t i=0; i<nChunks; i++) {
+            const std::vector<uint8_t> &data=buffers[i].getBuffer();
+            vectors[i].iov_base=const_cast<uint8_t *>(data.data());
+            vectors[i].iov_len=data.size();
+        }
+        writeVariableInteger(writer, length);
+        writer.writeGather(vectors.data(), vectors.size());
+    }
+    
+private:
+    const std::vector<T> &vector;
+    unsigned nThreads;
+    size_t chunkSize;
+};
+
+/** Wrap a vector for parallel serialization **/
+template <class T>
+inline Parallel<T> parallel(const std::vector<T> &vector, unsigned nThreads=0,
+        size_t chunkSize=0) {
+    return Parallel<T>(vector, nThreads, chunkSize);
+}
+
+}
+
+#endif
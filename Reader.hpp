@@ -7,12 +7,18 @@
 #ifndef __ROHAN_READER_HPP
 #define __ROHAN_READER_HPP
 
+#include <climits>
 #include <cstdint>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
+#include <stdexcept>
 #include <string>
+#include <typeinfo>
 #include <vector>
+#include "Statistics.hpp"
+#include "VariableInteger.hpp"
 
 namespace rohan {
 
@@ -24,6 +30,23 @@ inline T _read(class Reader &stream) {
 /** This exception indicates that end of file or stream was reached **/
 class End {};
 
+/** This exception indicates that data are corrupted or exceed the limits **/
+class Malformed : public std::runtime_error {
+public:
+    explicit Malformed(const char * message) : std::runtime_error(message) {}
+};
+
+/** Limits which are checked while reading untrusted data **/
+struct Limits {
+    /** Maximal number of elements of a string or a container **/
+    size_t maxLength=SIZE_MAX;
+    /** Maximal nesting depth of containers and pointers **/
+    unsigned maxDepth=UINT_MAX;
+};
+
+class ReferenceTable;
+class StringDictionary;
+
 /** Abstract data source **/
 class Reader {
 public:
@@ -35,6 +58,11 @@ public:
     virtual size_t skip(size_t length)=0;
     /** Read a portion of data, throw End() if could not be read completely **/
     virtual void readFully(void * to, size_t length);
+    /** Skip a portion of data, throw End() if could not be skipped completely **/
+    void skipFully(size_t length);
+    /** Returns a pointer to the next portion of data and skips it if the data
+        are kept in memory as long as the source exists, otherwise nullptr **/
+    virtual const void * borrow(size_t length) { (void)length; return nullptr; }
     /** Unserialize a value using "type conversion" style **/
     template <class T, typename std::enable_if<std::is_constructible<T, Reader &>::value, int>::type=0>
     inline explicit operator T() {
@@ -51,9 +79,45 @@ public:
         first=T(*this);
         get(rest...);
     }
+    /** Returns the dictionary used to deduplicate strings or nullptr **/
+    StringDictionary * getDictionary() const { return dictionary; }
+    /** Deduplicate strings with the dictionary, nullptr turns it off **/
+    void setDictionary(StringDictionary * dictionary) { this->dictionary=dictionary; }
+    /** Returns the table used to track shared objects or nullptr **/
+    ReferenceTable * getReferences() const { return references; }
+    /** Resolve references to shared objects, nullptr turns it off **/
+    void setReferences(ReferenceTable * references) { this->references=references; }
+    /** Returns the limits **/
+    const Limits &getLimits() const { return limits; }
+    /** Set the limits **/
+    void setLimits(const Limits &limits) { this->limits=limits; }
     
 private:
+    friend class _Nesting;
+    
     void get();
+    
+    StringDictionary * dictionary=nullptr;
+    ReferenceTable * references=nullptr;
+    Limits limits;
+    unsigned depth=0;
+};
+
+/** Tracks nesting depth of containers being read **/
+class _Nesting {
+public:
+    explicit _Nesting(Reader &stream) : stream(stream) {
+        if (++stream.depth>stream.limits.maxDepth) {
+            stream.depth--;
+            throw Malformed("nesting is too deep");
+        }
+    }
+    ~_Nesting() { stream.depth--; }
+    _Nesting(const _Nesting &)=delete;
+    _Nesting &operator =(const _Nesting &)=delete;
+    
+private:
+    Reader &stream;
 };
 
 inline void Reader::readFully(void * to, size_t length) {
@@ -61,14 +125,81 @@ inline void Reader::readFully(void * to, size_t length) {
         throw End();
 }
 
-unsigned long long readVariableInteger(Reader &stream);
+inline void Reader::skipFully(size_t length) {
+    if (length!=skip(length))
+        throw End();
+}
+
+inline unsigned long long readVariableInteger(Reader &stream) {
+    _ROHAN_COUNT(varints);
+    unsigned long long result=0;
+    uint8_t byte=0x80;
+    unsigned shift=0;
+    while (byte&0x80) {
+        if (shift>=64)
+            throw Malformed("variable integer is too long");
+        stream.readFully(&byte, sizeof(byte));
+        result|=((unsigned long long)(byte&0x7f)<<shift);
+        shift+=7;
+    }
+    // The tenth byte holds the only remaining bit
+    if (shift==70&&byte>1)
+        throw Malformed("variable integer is too long");
+    return result;
+}
 
-signed long long readSignedVariableInteger(Reader &stream);
+inline signed long long readSignedVariableInteger(Reader &stream) {
+    unsigned long long tmp=readVariableInteger(stream);
+    return ((1&tmp)?(tmp^(~0)):tmp)>>1;
+}
 
-template <class T>
-inline T _decodeZigzag(T value) {
-    typename std::make_unsigned<T>::type _value=value;
-    return (_value>>1)^-(_value&1);
+/** Read length of a string or a container, and check it against the limits **/
+inline size_t readLength(Reader &stream) {
+    unsigned long long result=readVariableInteger(stream);
+    if (result>stream.getLimits().maxLength)
+        throw Malformed("length exceeds the limit");
+    return result;
+}
+
+/** Read a portion of data into the byte array, replacing its content. The
+    array grows by pages as the data arrive, so that a corrupted length does
+    not cause a huge allocation. **/
+inline void readPaged(Reader &stream, std::vector<uint8_t> &buffer, size_t length) {
+    const size_t PAGE_SIZE=65536;
+    buffer.clear();
+    while (length>0) {
+        size_t portion=std::min(length, PAGE_SIZE);
+        size_t offset=buffer.size();
+        buffer.resize(offset+portion);
+        stream.readFully(&buffer[offset], portion);
+        length-=portion;
+    }
+}
+
+/** Read a reference to a known string, or return nullptr if a new string
+    follows, which must be passed to addDictionaryString() after reading **/
+ROHAN_INLINE const std::string * readDictionaryString(Reader &stream);
+
+/** Add a string to the dictionary of the reader **/
+ROHAN_INLINE void addDictionaryString(Reader &stream, const std::string &string);
+
+/** Returns a shared object of the type which was already read **/
+ROHAN_INLINE std::shared_ptr<void> getSharedObject(Reader &stream, size_t id,
+    const std::type_info &type);
+
+/** Reserve an identifier for a new shared object before reading it **/
+ROHAN_INLINE size_t reserveSharedObject(Reader &stream);
+
+/** Store a new shared object of the type which was read **/
+ROHAN_INLINE void setSharedObject(Reader &stream, size_t id,
+    const std::shared_ptr<void> &object, const std::type_info &type);
+
+inline bool _read(Reader &stream, bool * dummy=nullptr) {
+    (void)dummy;
+    // Any byte is a valid boolean value
+    uint8_t result;
+    stream.readFully(&result, sizeof(result));
+    return result!=0;
 }
 
 #define _R_FIXED(T) \
@@ -91,7 +222,6 @@ inline T _decodeZigzag(T value) {
         return _decodeZigzag<T>(readVariableInteger(stream)); \
     }
 
-_R_FIXED(bool)
 _R_FIXED(char)
 _R_FIXED(int8_t)
 _R_FIXED(uint8_t)
@@ -123,19 +253,34 @@ template <class T>
 std::basic_string<T> _read(Reader &stream, std::basic_string<T> * dummy) {
     (void)dummy;
     const size_t PAGE_SIZE=4096;
+    [[maybe_unused]] bool isNew=false;
+    if constexpr (std::is_same_v<T, char>) {
+        if (stream.getDictionary()) {
+            if (const std::string * known=readDictionaryString(stream))
+                return *known;
+            isNew=true;
+        }
+    }
+    _ROHAN_COUNT(strings);
     std::basic_string<T> result;
-    size_t n=readVariableInteger(stream);
+    size_t n=readLength(stream);
     result.reserve(std::min(PAGE_SIZE, n));
     while (n-->0)
         result.push_back(T(stream));
+    if constexpr (std::is_same_v<T, char>) {
+        if (isNew)
+            addDictionaryString(stream, result);
+    }
     return result;
 }
 
 template <class T>
 std::list<T> _read(Reader &stream, std::list<T> * dummy) {
     (void)dummy;
+    _Nesting nesting(stream);
+    _ROHAN_COUNT(containers);
     std::list<T> result;
-    size_t n=readVariableInteger(stream);
+    size_t n=readLength(stream);
     for (size_t i=0; i<n; i++)
         result.emplace_back(stream);
     return result;
@@ -144,8 +289,10 @@ std::list<T> _read(Reader &stream, std::list<T> * dummy) {
 template <class T>
 std::vector<T> _read(Reader &stream, std::vector<T> * dummy) {
     (void)dummy;
+    _Nesting nesting(stream);
+    _ROHAN_COUNT(containers);
     std::vector<T> result;
-    size_t n=readVariableInteger(stream);
+    size_t n=readLength(stream);
     for (size_t i=0; i<n; i++)
         result.emplace_back(stream);
     return result;
@@ -160,8 +307,10 @@ std::pair<X, Y> _read(Reader &stream, std::pair<X, Y> * dummy) {
 template <class K, class V>
 std::map<K, V> _read(Reader &stream, std::map<K, V> * dummy) {
     (void)dummy;
+    _Nesting nesting(stream);
+    _ROHAN_COUNT(containers);
     std::map<K, V> result;
-    size_t length=readVariableInteger(stream);
+    size_t length=readLength(stream);
     for (size_t i=0; i<length; i++)
         result.insert(std::pair<K, V>(stream));
     return result;
@@ -170,13 +319,56 @@ std::map<K, V> _read(Reader &stream, std::map<K, V> * dummy) {
 template <class T>
 std::set<T> _read(Reader &stream, std::set<T> * dummy) {
     (void)dummy;
+    _Nesting nesting(stream);
+    _ROHAN_COUNT(containers);
     std::set<T> result;
-    size_t length=readVariableInteger(stream);
+    size_t length=readLength(stream);
+#ifdef ROHAN_DELTA_SETS
+    if constexpr (std::is_integral_v<T>&&!std::is_same_v<T, bool>) {
+        uint64_t previous=0;
+        while (length-->0) {
+            previous+=readVariableInteger(stream);
+            result.emplace_hint(result.end(), T(previous));
+        }
+        return result;
+    }
+#endif
     while (length-->0)
         result.emplace(stream);
     return result;
 }
 
+template <class T>
+std::unique_ptr<T> _read(Reader &stream, std::unique_ptr<T> * dummy) {
+    (void)dummy;
+    _Nesting nesting(stream);
+    if (!bool(stream))
+        return nullptr;
+    if constexpr (std::is_constructible_v<T, Reader &>)
+        return std::make_unique<T>(stream);
+    else
+        return std::make_unique<T>(T(stream));
+}
+
+template <class T>
+std::shared_ptr<T> _read(Reader &stream, std::shared_ptr<T> * dummy) {
+    (void)dummy;
+    _Nesting nesting(stream);
+    size_t tag=readVariableInteger(stream);
+    if (!tag)
+        return nullptr;
+    if (tag>1)
+        return std::static_pointer_cast<T>(getSharedObject(stream, tag-2, typeid(T)));
+    size_t id=reserveSharedObject(stream);
+    std::shared_ptr<T> result;
+    if constexpr (std::is_constructible_v<T, Reader &>)
+        result=std::make_shared<T>(stream);
+    else
+        result=std::make_shared<T>(T(stream));
+    setSharedObject(stream, id, result, typeid(T));
+    return result;
+}
+
 template<class T, typename = std::enable_if_t<std::is_enum_v<T>>>
 T _read(Reader &stream, T * dummy) {
     (void)dummy;
@@ -216,4 +408,9 @@ bool operator !=(Reader &reader, const T &refValue) {
 
 }
 
+#ifdef ROHAN_HEADER_ONLY
+#include "ReferenceTable.hpp"
+#include "StringDictionary.hpp"
+#endif
+
 #endif
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Tracking of shared objects
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include "ReferenceTable.hpp"
+
+namespace rohan {
+
+/******************************************************************************/
+
+inline size_t _hashObject(const void * object, unsigned bits) {
+    // Fibonacci hashing, low bits of pointers are always zero
+    return ((uintptr_t(object)>>4)*0x9E3779B97F4A7C15ULL)>>(64-bits);
+}
+
+ROHAN_INLINE ReferenceTable::ReferenceTable(size_t expected) : writer(false),
+        bits(MIN_BITS), count(0) {
+    // Keep the load factor below 1/2
+    while ((size_t(1)<<bits)<2*expected)
+        bits++;
+}
+
+ROHAN_INLINE std::pair<size_t, bool> ReferenceTable::insert(const std::shared_ptr<const void> &object) {
+    if (slots.empty()) {
+        writer=true;
+        slots.assign(size_t(1)<<bits, Slot{nullptr, 0, false});
+    }
+    Slot &slot=find(object.get());
+    if (slot.object) {
+        if (slot.writing)
+            throw std::invalid_argument("cyclic object reference");
+        return {slot.id, false};
+    }
+    slot=Slot{object, count++, true};
+    if (2*count>slots.size())
+        grow();
+    return {count-1, true};
+}
+
+ROHAN_INLINE void ReferenceTable::finish(const void * object) {
+    if (!slots.empty())
+        find(object).writing=false;
+}
+
+ROHAN_INLINE ReferenceTable::Slot &ReferenceTable::find(const void * object) {
+    // Returns the slot of the object or an empty slot where it belongs
+    size_t mask=slots.size()-1;
+    for (size_t i=_hashObject(object, bits);; i=(i+1)&mask) {
+        Slot &slot=slots[i];
+        if (!slot.object||slot.object.get()==object)
+            return slot;
+    }
+}
+
+ROHAN_INLINE size_t ReferenceTable::reserve() {
+    objects.emplace_back();
+    return objects.size()-1;
+}
+
+ROHAN_INLINE void ReferenceTable::set(size_t id, const std::shared_ptr<void> &object,
+        const std::type_info &type) {
+    objects.at(id)=Object{object, &type};
+}
+
+ROHAN_INLINE const std::shared_ptr<void> &ReferenceTable::get(size_t id,
+        const std::type_info &type) const {
+    if (id>=objects.size())
+        throw Malformed("unknown object reference");
+    const Object &result=objects[id];
+    if (!result.object)
+        throw Malformed("cyclic object reference");
+    if (*result.type!=type)
+        throw Malformed("object reference of another type");
+    return result.object;
+}
+
+ROHAN_INLINE void ReferenceTable::clear() {
+    slots.clear();
+    objects.clear();
+    count=0;
+}
+
+ROHAN_INLINE void ReferenceTable::grow() {
+    std::vector<Slot> old(size_t(1)<<++bits, Slot{nullptr, 0, false});
+    old.swap(slots);
+    size_t mask=slots.size()-1;
+    for (Slot &slot: old) {
+        if (slot.object) {
+            size_t i=_hashObject(slot.object.get(), bits);
+            while (slots[i].object)
+                i=(i+1)&mask;
+            slots[i]=std::move(slot);
+        }
+    }
+}
+
+/******************************************************************************/
+
+ROHAN_INLINE bool writeSharedObject(Writer &stream, const std::shared_ptr<const void> &object) {
+    ReferenceTable * table=stream.getReferences();
+    if (table) {
+        auto result=table->insert(object);
+        if (!result.second) {
+            writeVariableInteger(stream, result.first+2);
+            return true;
+        }
+    }
+    writeVariableInteger(stream, 1);
+    return false;
+}
+
+ROHAN_INLINE void finishSharedObject(Writer &stream, const void * object) {
+    if (ReferenceTable * table=stream.getReferences())
+        table->finish(object);
+}
+
+ROHAN_INLINE std::shared_ptr<void> getSharedObject(Reader &stream, size_t id,
+        const std::type_info &type) {
+    ReferenceTable * table=stream.getReferences();
+    if (!table)
+        throw Malformed("object reference without a table");
+    return table->get(id, type);
+}
+
+ROHAN_INLINE size_t reserveSharedObject(Reader &stream) {
+    ReferenceTable * table=stream.getReferences();
+    return table?table->reserve():0;
+}
+
+ROHAN_INLINE void setSharedObject(Reader &stream, size_t id,
+        const std::shared_ptr<void> &object, const std::type_info &type) {
+    if (ReferenceTable * table=stream.getReferences())
+        table->set(id, object, type);
+}
+
+}
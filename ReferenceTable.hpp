@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Tracking of shared objects
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_REFERENCETABLE_HPP
+#define __ROHAN_REFERENCETABLE_HPP
+
+#include <typeinfo>
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Table of shared objects which were already written or read. A shared
+    pointer is written as a varint: 0 is nullptr, 1 is followed by a new
+    object, n refers to the object number n-2. Without a table every object
+    is written again. The same object must always be referred with the same
+    pointer type: the reader throws Malformed if a reference points to an
+    object of another type. Cycles cannot be written: the writer throws
+    std::invalid_argument if an object refers to itself while it is being
+    written. The writer side keeps written objects alive, so that their
+    addresses are not reused by new objects while the table exists. **/
+class ReferenceTable {
+public:
+    /** Create a table, expected is the anticipated number of objects **/
+    explicit ReferenceTable(size_t expected=0);
+    /** Returns the number of objects **/
+    size_t size() const { return writer?count:objects.size(); }
+    /** Returns identifier of an object and true if the object is new, throws
+        std::invalid_argument if the object is being written (writer side) **/
+    std::pair<size_t, bool> insert(const std::shared_ptr<const void> &object);
+    /** Mark a new object as completely written (writer side) **/
+    void finish(const void * object);
+    /** Reserve an identifier for an object being read (reader side) **/
+    size_t reserve();
+    /** Store an object of the type which was read (reader side) **/
+    void set(size_t id, const std::shared_ptr<void> &object,
+        const std::type_info &type);
+    /** Returns an object which was read, if it has the type (reader side) **/
+    const std::shared_ptr<void> &get(size_t id, const std::type_info &type) const;
+    /** Forget all objects **/
+    void clear();
+    
+private:
+    static const unsigned MIN_BITS=6;
+    
+    struct Slot {
+        std::shared_ptr<const void> object;
+        size_t id;
+        bool writing;
+    };
+    
+    struct Object {
+        std::shared_ptr<void> object;
+        const std::type_info * type;
+    };
+    
+    Slot &find(const void * object);
+    void grow();
+    
+    bool writer;
+    unsigned bits;
+    size_t count;
+    std::vector<Slot> slots;
+    std::vector<Object> objects;
+};
+
+}
+
+#ifdef ROHAN_HEADER_ONLY
+#include "ReferenceTable.cpp"
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization into chains of buffers
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <cstring>
+#include "SegmentedSerialization.hpp"
+
+using namespace rohan;
+using std::vector;
+
+/******************************************************************************/
+
+SegmentedWriter::SegmentedWriter(size_t segmentSize) :
+        segmentSize(segmentSize?segmentSize:1), total(0) {}
+
+vector<iovec> SegmentedWriter::getSegments() const {
+    vector<iovec> result;
+    result.reserve(segments.size());
+    for (const Segment &segment: segments)
+        if (segment.size)
+            result.push_back(iovec{segment.data.get(), segment.size});
+    return result;
+}
+
+vector<uint8_t> SegmentedWriter::toVector() const {
+    vector<uint8_t> result(total);
+    size_t offset=0;
+    for (const Segment &segment: segments) {
+        if (segment.size)
+            memcpy(&result[offset], segment.data.get(), segment.size);
+        offset+=segment.size;
+    }
+    return result;
+}
+
+void SegmentedWriter::writeTo(Writer &writer) const {
+    vector<iovec> vectors=getSegments();
+    writer.writeGather(vectors.data(), vectors.size());
+}
+
+void SegmentedWriter::clear() {
+    if (segments.size()>1)
+        segments.resize(1);
+    if (!segments.empty())
+        segments[0].size=0;
+    total=0;
+}
+
+void SegmentedWriter::write(const void * from, size_t length) {
+    const uint8_t * data=static_cast<const uint8_t *>(from);
+    while (length>0) {
+        if (segments.empty()||segments.back().size==segments.back().capacity) {
+            // Large portions get a segment of their own size
+            size_t capacity=std::max(segmentSize, length);
+            // The data are written before they are read, so no need to zero them
+            segments.push_back(Segment{std::unique_ptr<uint8_t[]>(new uint8_t[capacity]), capacity, 0});
+        }
+        Segment &segment=segments.back();
+        size_t portion=std::min(length, segment.capacity-segment.size);
+        memcpy(segment.data.get()+segment.size, data, portion);
+        segment.size+=portion;
+        total+=portion;
+        data+=portion;
+        length-=portion;
+    }
+}
+
+/******************************************************************************/
+
+SegmentedReader::SegmentedReader(const struct iovec * vectors, size_t count) :
+        segments(vectors, vectors+count), index(0), offset(0), remaining(0) {
+    for (const iovec &segment: segments)
+        remaining+=segment.iov_len;
+    next();
+}
+
+SegmentedReader::SegmentedReader(const vector<struct iovec> &segments) :
+        SegmentedReader(segments.data(), segments.size()) {}
+
+size_t SegmentedReader::read(void * to, size_t length) {
+    uint8_t * out=static_cast<uint8_t *>(to);
+    size_t result=0;
+    while (result<length&&remaining) {
+        const iovec &segment=segments[index];
+        size_t portion=std::min(length-result, segment.iov_len-offset);
+        memcpy(out+result, static_cast<const uint8_t *>(segment.iov_base)+offset, portion);
+        offset+=portion;
+        remaining-=portion;
+        result+=portion;
+        next();
+    }
+    return result;
+}
+
+size_t SegmentedReader::skip(size_t length) {
+    size_t result=0;
+    while (result<length&&remaining) {
+        size_t portion=std::min(length-result, segments[index].iov_len-offset);
+        offset+=portion;
+        remaining-=portion;
+        result+=portion;
+        next();
+    }
+    return result;
+}
+
+const void * SegmentedReader::borrow(size_t length) {
+    if (!remaining||segments[index].iov_len-offset<length)
+        return nullptr;
+    const void * result=static_cast<const uint8_t *>(segments[index].iov_base)+offset;
+    offset+=length;
+    remaining-=length;
+    next();
+    return result;
+}
+
+void SegmentedReader::next() {
+    // Move to the next non-empty segment
+    while (index<segments.size()&&offset==segments[index].iov_len) {
+        index++;
+        offset=0;
+    }
+}
@@ -0,0 +1,75 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization into chains of buffers
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_SEGMENTEDSERIALIZATION_HPP
+#define __ROHAN_SEGMENTEDSERIALIZATION_HPP
+
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Writer which appends data to a chain of segments. Unlike ByteArrayWriter,
+    written data are never moved or copied when the output grows. **/
+class SegmentedWriter : public Writer {
+public:
+    /** Create a writer which allocates segments of segmentSize bytes **/
+    explicit SegmentedWriter(size_t segmentSize=65536);
+    /** Returns the total size of written data **/
+    size_t size() const { return total; }
+    /** Returns the written data as a list of buffers **/
+    std::vector<struct iovec> getSegments() const;
+    /** Copy the written data into a single buffer **/
+    std::vector<uint8_t> toVector() const;
+    /** Write the data to another stream at once **/
+    void writeTo(Writer &writer) const;
+    /** Discard the data, keeping the first segment for reuse **/
+    void clear();
+    /** Write a portion of data **/
+    void write(const void * from, size_t length) override;
+    
+private:
+    struct Segment {
+        std::unique_ptr<uint8_t[]> data;
+        size_t capacity;
+        size_t size;
+    };
+    
+    size_t segmentSize;
+    size_t total;
+    std::vector<Segment> segments;
+};
+
+/** Reader of data kept in several buffers, such as received packets. The
+    buffers must exist as long as the reader. **/
+class SegmentedReader : public Reader {
+public:
+    /** Create a reader of the buffers **/
+    SegmentedReader(const struct iovec * vectors, size_t count);
+    /** Create a reader of the buffers **/
+    explicit SegmentedReader(const std::vector<struct iovec> &segments);
+    /** Returns the number of bytes that can be read **/
+    size_t available() const { return remaining; }
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    /** Borrow a portion of data if it lies within a single buffer **/
+    const void * borrow(size_t length) override;
+    
+private:
+    void next();
+    
+    std::vector<struct iovec> segments;
+    size_t index;
+    size_t offset;
+    size_t remaining;
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Compact encodings of integer sequences
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <cstring>
+#include "SequenceSerialization.hpp"
+
+using namespace rohan;
+using std::vector;
+
+/******************************************************************************/
+
+static const size_t BLOCK_SIZE=128;
+
+/** Packed values are accessed with 16-byte loads and stores **/
+static const size_t PADDING=16;
+
+using Word=unsigned __int128;
+
+static inline unsigned getBitWidth(uint64_t value) {
+    return value?64-__builtin_clzll(value):0;
+}
+
+static void pack(const uint64_t * values, size_t count, uint64_t reference,
+        unsigned width, uint8_t * to) {
+    for (size_t i=0; i<count; i++) {
+        size_t position=i*width;
+        Word word;
+        memcpy(&word, to+position/8, sizeof(word));
+        word|=Word(values[i]-reference)<<(position%8);
+        memcpy(to+position/8, &word, sizeof(word));
+    }
+}
+
+static void unpack(const uint8_t * from, size_t count, uint64_t reference,
+        unsigned width, uint64_t * values) {
+    // Iterations are independent, so the compiler may vectorize the loop
+    uint64_t mask=width<64?(uint64_t(1)<<width)-1:~uint64_t(0);
+    for (size_t i=0; i<count; i++) {
+        size_t position=i*width;
+        Word word;
+        memcpy(&word, from+position/8, sizeof(word));
+        values[i]=reference+(uint64_t(word>>(position%8))&mask);
+    }
+}
+
+static void encodeDeltas(vector<uint64_t> &values) {
+    uint64_t previous=0;
+    for (uint64_t &value: values) {
+        uint64_t current=value;
+        value=_encodeZigzag<int64_t>(current-previous);
+        previous=current;
+    }
+}
+
+static void decodeDeltas(vector<uint64_t> &values) {
+    uint64_t previous=0;
+    for (uint64_t &value: values)
+        value=previous+=_decodeZigzag<int64_t>(value);
+}
+
+void rohan::writeDeltas(Writer &writer, const vector<uint64_t> &values) {
+    writeVariableInteger(writer, values.size());
+    uint64_t previous=0;
+    for (uint64_t value: values) {
+        writeVariableInteger(writer, _encodeZigzag<int64_t>(value-previous));
+        previous=value;
+    }
+}
+
+vector<uint64_t> rohan::readDeltas(Reader &reader) {
+    size_t count=readLength(reader);
+    vector<uint64_t> result;
+    for (size_t i=0; i<count; i++)
+        result.push_back(readVariableInteger(reader));
+    decodeDeltas(result);
+    return result;
+}
+
+void rohan::writeBitPacked(Writer &writer, vector<uint64_t> values, bool delta) {
+    if (delta)
+        encodeDeltas(values);
+    writeVariableInteger(writer, values.size());
+    vector<uint8_t> packed;
+    for (size_t offset=0; offset<values.size(); offset+=BLOCK_SIZE) {
+        const uint64_t * block=&values[offset];
+        size_t count=std::min(BLOCK_SIZE, values.size()-offset);
+        uint64_t minimum=block[0], maximum=block[0];
+        for (size_t i=1; i<count; i++) {
+            minimum=std::min(minimum, block[i]);
+            maximum=std::max(maximum, block[i]);
+        }
+        uint8_t width=getBitWidth(maximum-minimum);
+        size_t length=(count*width+7)/8;
+        packed.assign(length+PADDING, 0);
+        pack(block, count, minimum, width, packed.data());
+        
+        writeVariableInteger(writer, minimum);
+        writer | width;
+        writer.write(packed.data(), length);
+    }
+}
+
+vector<uint64_t> rohan::readBitPacked(Reader &reader, bool delta) {
+    size_t count=readLength(reader);
+    vector<uint64_t> result;
+    vector<uint8_t> packed;
+    for (size_t offset=0; offset<count; offset+=BLOCK_SIZE) {
+        size_t blockCount=std::min(BLOCK_SIZE, count-offset);
+        uint64_t minimum=readVariableInteger(reader);
+        uint8_t width=uint8_t(reader);
+        if (width>64)
+            throw Malformed("malformed bit-packed block");
+        size_t length=(blockCount*width+7)/8;
+        packed.assign(length+PADDING, 0);
+        reader.readFully(packed.data(), length);
+        result.resize(offset+blockCount);
+        unpack(packed.data(), blockCount, minimum, width, &result[offset]);
+    }
+    if (delta)
+        decodeDeltas(result);
+    return result;
+}
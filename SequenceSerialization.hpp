@@ -0,0 +1,108 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Compact encodings of integer sequences
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_SEQUENCESERIALIZATION_HPP
+#define __ROHAN_SEQUENCESERIALIZATION_HPP
+
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Write the count and differences between adjacent values **/
+void writeDeltas(Writer &writer, const std::vector<uint64_t> &values);
+
+/** Read values written by writeDeltas() **/
+std::vector<uint64_t> readDeltas(Reader &reader);
+
+/** Write the count and values in blocks of 128, every block is stored as its
+    minimum and bit-packed differences from the minimum (frame of reference).
+    If delta is true, differences between adjacent values are packed. **/
+void writeBitPacked(Writer &writer, std::vector<uint64_t> values, bool delta);
+
+/** Read values written by writeBitPacked() **/
+std::vector<uint64_t> readBitPacked(Reader &reader, bool delta);
+
+/** Base class for wrappers of integer containers **/
+template <class C>
+class _IntegerSequence {
+public:
+    using Value=typename C::value_type;
+    static_assert(std::is_integral_v<Value>, "integer container is expected");
+    
+    /** Returns the container **/
+    const C &get() const { return reference?*reference:value; }
+    /** Returns the container **/
+    operator const C &() const { return get(); }
+    
+protected:
+    explicit _IntegerSequence(const C &container) : reference(&container) {}
+    explicit _IntegerSequence(std::vector<uint64_t> &&values) : reference(nullptr) {
+        for (uint64_t element: values)
+            value.insert(value.end(), fromKey(element));
+    }
+    /** Values as unsigned keys which keep the order of the values **/
+    std::vector<uint64_t> getKeys() const {
+        std::vector<uint64_t> result;
+        result.reserve(get().size());
+        for (Value element: get())
+            result.push_back(toKey(element));
+        return result;
+    }
+    
+private:
+    static const uint64_t BIAS=std::is_signed_v<Value>?uint64_t(1)<<63:0;
+    
+    static uint64_t toKey(Value element) {
+        return static_cast<uint64_t>(element)^BIAS;
+    }
+    static Value fromKey(uint64_t key) {
+        return static_cast<Value>(key^BIAS);
+    }
+    
+    C value;
+    const C * reference;
+};
+
+/** Integer container written as differences between adjacent values. Best
+    suited for sorted sequences of timestamps or identifiers. **/
+template <class C>
+class Delta : public _IntegerSequence<C> {
+public:
+    /** Wrap a container for writing **/
+    explicit Delta(const C &container) : _IntegerSequence<C>(container) {}
+    /** Read a container **/
+    explicit Delta(Reader &reader) : _IntegerSequence<C>(readDeltas(reader)) {}
+    /** Write the container **/
+    void serialize(Writer &writer) const {
+        writeDeltas(writer, this->getKeys());
+    }
+};
+
+/** Integer container written with frame-of-reference bit packing, if delta
+    is true, differences between adjacent values are packed. **/
+template <class C, bool delta=false>
+class BitPacked : public _IntegerSequence<C> {
+public:
+    /** Wrap a container for writing **/
+    explicit BitPacked(const C &container) : _IntegerSequence<C>(container) {}
+    /** Read a container **/
+    explicit BitPacked(Reader &reader) :
+            _IntegerSequence<C>(readBitPacked(reader, delta)) {}
+    /** Write the container **/
+    void serialize(Writer &writer) const {
+        writeBitPacked(writer, this->getKeys(), delta);
+    }
+};
+
+/** Sorted integer container, bit-packed differences **/
+template <class C>
+using DeltaBitPacked=BitPacked<C, true>;
+
+}
+
+#endif
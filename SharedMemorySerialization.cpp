@@ -0,0 +1,274 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization through a ring buffer in shared memory
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "SharedMemorySerialization.hpp"
+
+using namespace rohan;
+using std::atomic;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::string;
+
+/******************************************************************************/
+
+static const uint32_t MAGIC=0x52494e47;
+static const unsigned SPINS=256;
+
+/** Busy waiting is useless on a single processor **/
+static const bool MULTIPROCESSOR=std::thread::hardware_concurrency()>1;
+
+/** Indices of each side are kept in separate cache lines, so that the
+    producer and the consumer do not invalidate each other's caches **/
+struct rohan::_RingHeader {
+    /** Written by the producer **/
+    alignas(64) atomic<uint64_t> head;
+    atomic<uint32_t> headSignal;
+    atomic<uint32_t> closed;
+    /** Written by the consumer **/
+    alignas(64) atomic<uint64_t> tail;
+    atomic<uint32_t> tailSignal;
+    atomic<uint32_t> readerClosed;
+    /** Set by a side which sleeps in WAIT_BLOCK mode **/
+    alignas(64) atomic<uint32_t> readerWaits;
+    atomic<uint32_t> writerWaits;
+    /** Constant **/
+    alignas(64) uint64_t capacity;
+    uint32_t magic;
+};
+
+static void check(bool success) {
+    if (!success)
+        throw std::system_error(errno, std::generic_category());
+}
+
+static inline void relax() {
+#if defined(__x86_64__)||defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+static void futexWait(atomic<uint32_t> &word, uint32_t value) {
+    syscall(SYS_futex, &word, FUTEX_WAIT, value, nullptr, nullptr, 0);
+}
+
+static void futexWake(atomic<uint32_t> &word) {
+    syscall(SYS_futex, &word, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+/** Wait until an index differs from the known value or the ring is closed,
+    returns the new value of the index **/
+static uint64_t waitChange(const atomic<uint64_t> &index, uint64_t known,
+        atomic<uint32_t> &signal, atomic<uint32_t> &waits,
+        const atomic<uint32_t> &closed, WaitStrategy strategy) {
+    for (unsigned spin=0;; spin++) {
+        uint64_t value=index.load(memory_order_acquire);
+        if (value!=known||closed.load(memory_order_acquire))
+            return value;
+        if (strategy==WAIT_YIELD||(strategy==WAIT_SPIN&&!MULTIPROCESSOR))
+            sched_yield();
+        else if (strategy==WAIT_SPIN||(spin<SPINS&&MULTIPROCESSOR))
+            relax();
+        else {
+            // The other side wakes us up if it sees the flag after its update
+            uint32_t expected=signal.load();
+            waits.store(1);
+            if (index.load()==known&&!closed.load())
+                futexWait(signal, expected);
+            waits.store(0);
+        }
+    }
+}
+
+/** Tell the other side that an index was updated. The sides choose their
+    strategies independently, so the flag is checked whatever ours is. **/
+static void notify(atomic<uint32_t> &signal, atomic<uint32_t> &waits) {
+    // Order the preceding update of the index before reading the flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waits.load()) {
+        signal.fetch_add(1);
+        futexWake(signal);
+    }
+}
+
+static void * map(int fd, size_t size) {
+    void * result=mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    int error=errno;
+    close(fd);
+    if (result==MAP_FAILED)
+        throw std::system_error(error, std::generic_category());
+    return result;
+}
+
+/******************************************************************************/
+
+SharedMemoryWriter::SharedMemoryWriter(const string &name, size_t capacity,
+        WaitStrategy strategy) : name(name), strategy(strategy), mask(0),
+        position(0), published(0), tail(0) {
+    size_t size=64;
+    while (size<capacity)
+        size<<=1;
+    int fd=shm_open(name.c_str(), O_CREAT|O_EXCL|O_RDWR, 0600);
+    check(fd>=0);
+    if (ftruncate(fd, sizeof(_RingHeader)+size)) {
+        int error=errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::system_error(error, std::generic_category());
+    }
+    try {
+        header=new (map(fd, sizeof(_RingHeader)+size)) _RingHeader();
+    }
+    catch (...) {
+        shm_unlink(name.c_str());
+        throw;
+    }
+    data=reinterpret_cast<uint8_t *>(header+1);
+    mask=size-1;
+    header->capacity=size;
+    header->magic=MAGIC;
+}
+
+SharedMemoryWriter::~SharedMemoryWriter() {
+    flush();
+    header->closed.store(1);
+    notify(header->headSignal, header->readerWaits);
+    munmap(header, sizeof(_RingHeader)+mask+1);
+    shm_unlink(name.c_str());
+}
+
+void SharedMemoryWriter::write(const void * from, size_t length) {
+    const uint8_t * source=static_cast<const uint8_t *>(from);
+    size_t capacity=mask+1;
+    while (length>0) {
+        if (position-tail==capacity) {
+            tail=header->tail.load(memory_order_acquire);
+            if (position-tail==capacity) {
+                // Nobody will free the space
+                if (header->readerClosed.load(memory_order_acquire))
+                    throw End();
+                // The reader needs the data to free the space
+                flush();
+                tail=waitChange(header->tail, tail, header->tailSignal,
+                    header->writerWaits, header->readerClosed, strategy);
+                continue;
+            }
+        }
+        size_t offset=position&mask;
+        size_t portion=std::min({length, capacity-(position-tail), capacity-offset});
+        memcpy(data+offset, source, portion);
+        position+=portion;
+        source+=portion;
+        length-=portion;
+    }
+}
+
+void SharedMemoryWriter::flush() {
+    if (published!=position) {
+        header->head.store(position, memory_order_release);
+        published=position;
+        notify(header->headSignal, header->readerWaits);
+    }
+}
+
+/******************************************************************************/
+
+SharedMemoryReader::SharedMemoryReader(const string &name, WaitStrategy strategy) :
+        strategy(strategy), position(0), released(0), head(0) {
+    int fd=shm_open(name.c_str(), O_RDWR, 0);
+    check(fd>=0);
+    struct stat status;
+    if (fstat(fd, &status)||size_t(status.st_size)<sizeof(_RingHeader)) {
+        close(fd);
+        throw std::runtime_error("not a shared memory ring");
+    }
+    header=static_cast<_RingHeader *>(map(fd, status.st_size));
+    uint64_t capacity=header->capacity;
+    if (header->magic!=MAGIC||capacity&(capacity-1)||
+            sizeof(_RingHeader)+capacity!=size_t(status.st_size)) {
+        munmap(header, status.st_size);
+        throw std::runtime_error("not a shared memory ring");
+    }
+    data=reinterpret_cast<const uint8_t *>(header+1);
+    mask=capacity-1;
+    position=released=header->tail.load(memory_order_acquire);
+    head=header->head.load(memory_order_acquire);
+}
+
+SharedMemoryReader::~SharedMemoryReader() {
+    header->readerClosed.store(1);
+    notify(header->tailSignal, header->writerWaits);
+    munmap(header, sizeof(_RingHeader)+mask+1);
+}
+
+size_t SharedMemoryReader::available() {
+    head=header->head.load(memory_order_acquire);
+    return head-position;
+}
+
+size_t SharedMemoryReader::read(void * to, size_t length) {
+    return transfer(static_cast<uint8_t *>(to), length);
+}
+
+size_t SharedMemoryReader::skip(size_t length) {
+    return transfer(nullptr, length);
+}
+
+size_t SharedMemoryReader::transfer(uint8_t * to, size_t length) {
+    size_t result=0;
+    while (result<length) {
+        if (head==position) {
+            head=header->head.load(memory_order_acquire);
+            if (head==position) {
+                release();
+                if (header->closed.load(memory_order_acquire)) {
+                    // The writer published everything before closing
+                    head=header->head.load(memory_order_acquire);
+                    if (head==position)
+                        break;
+                    continue;
+                }
+                head=waitChange(header->head, head, header->headSignal,
+                    header->readerWaits, header->closed, strategy);
+                continue;
+            }
+        }
+        size_t offset=position&mask;
+        size_t portion=std::min({length-result, size_t(head-position), mask+1-offset});
+        if (to)
+            memcpy(to+result, data+offset, portion);
+        position+=portion;
+        result+=portion;
+    }
+    // Free the space in batches, or at once if the writer waits
+    if (position-released>=(mask+1)/8||header->writerWaits.load(memory_order_acquire))
+        release();
+    return result;
+}
+
+void SharedMemoryReader::release() {
+    if (released!=position) {
+        header->tail.store(position, memory_order_release);
+        released=position;
+        notify(header->tailSignal, header->writerWaits);
+    }
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization through a ring buffer in shared memory
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_SHAREDMEMORYSERIALIZATION_HPP
+#define __ROHAN_SHAREDMEMORYSERIALIZATION_HPP
+
+#include <string>
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** How a side of the ring waits for the other one. The writer and the
+    reader may use different strategies. **/
+enum WaitStrategy : uint8_t {
+    /** Busy loop, lowest latency, occupies a processor core (yields on a
+        single processor) **/
+    WAIT_SPIN,
+    /** Busy loop which yields the processor to other threads **/
+    WAIT_YIELD,
+    /** Short busy loop, then sleep in the kernel until woken up **/
+    WAIT_BLOCK
+};
+
+struct _RingHeader;
+
+/** Writer to a single-producer single-consumer ring buffer in POSIX shared
+    memory. The writer creates the shared memory object and removes its name
+    when destroyed. Written data become visible to the reader on flush(), or
+    when the ring is full. **/
+class SharedMemoryWriter : public Writer {
+public:
+    /** Create a ring of the given capacity, rounded up to a power of two **/
+    SharedMemoryWriter(const std::string &name, size_t capacity,
+        WaitStrategy strategy=WAIT_BLOCK);
+    SharedMemoryWriter(const SharedMemoryWriter &)=delete;
+    SharedMemoryWriter &operator =(const SharedMemoryWriter &)=delete;
+    /** Publish the data and tell the reader that no more data follow **/
+    ~SharedMemoryWriter();
+    /** Write a portion of data, waits while the ring is full. Throws End if
+        the ring is full and the reader is destroyed. **/
+    void write(const void * from, size_t length) override;
+    /** Publish written data to the reader **/
+    void flush() override;
+    
+private:
+    std::string name;
+    WaitStrategy strategy;
+    _RingHeader * header;
+    uint8_t * data;
+    size_t mask;
+    uint64_t position;
+    uint64_t published;
+    uint64_t tail;
+};
+
+/** Reader from a ring buffer created by SharedMemoryWriter. Reading waits
+    for data and returns less data only after the writer is destroyed. **/
+class SharedMemoryReader : public Reader {
+public:
+    /** Open an existing ring **/
+    explicit SharedMemoryReader(const std::string &name,
+        WaitStrategy strategy=WAIT_BLOCK);
+    SharedMemoryReader(const SharedMemoryReader &)=delete;
+    SharedMemoryReader &operator =(const SharedMemoryReader &)=delete;
+    /** Tell the writer that no more data are read and unmap the ring **/
+    ~SharedMemoryReader();
+    /** Returns the number of bytes which can be read without waiting **/
+    size_t available();
+    /** Read a portion of data **/
+    size_t read(void * to, size_t length) override;
+    /** Skip a portion of data **/
+    size_t skip(size_t length) override;
+    
+private:
+    size_t transfer(uint8_t * to, size_t length);
+    void release();
+    
+    WaitStrategy strategy;
+    _RingHeader * header;
+    const uint8_t * data;
+    size_t mask;
+    uint64_t position;
+    uint64_t released;
+    uint64_t head;
+};
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Memory-mapped sorted tables
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SortedTable.hpp"
+
+using namespace rohan;
+using std::vector;
+
+/******************************************************************************/
+
+/** Header: magic, page size, number of entries, number of pages, length of
+    keys and length of values, all little-endian. It is followed by offsets
+    of the pages (8 bytes each), keys and values. **/
+static const uint32_t MAGIC=0x42545352;
+static const size_t HEADER_SIZE=40;
+
+static void store(uint8_t * to, uint64_t value, unsigned size) {
+    for (unsigned i=0; i<size; i++)
+        to[i]=uint8_t(value>>(8*i));
+}
+
+static uint64_t load(const uint8_t * from, unsigned size) {
+    uint64_t result=0;
+    for (unsigned i=0; i<size; i++)
+        result|=uint64_t(from[i])<<(8*i);
+    return result;
+}
+
+static void corrupted() {
+    throw Malformed("corrupted sorted table");
+}
+
+void rohan::_writeSortedTable(Writer &writer, uint64_t count, unsigned pageSize,
+        const vector<uint64_t> &pages, const vector<uint8_t> &keys,
+        const vector<uint8_t> &values) {
+    uint8_t header[HEADER_SIZE];
+    store(header, MAGIC, 4);
+    store(header+4, pageSize, 4);
+    store(header+8, count, 8);
+    store(header+16, pages.size(), 8);
+    store(header+24, keys.size(), 8);
+    store(header+32, values.size(), 8);
+    vector<uint8_t> index(8*pages.size());
+    for (size_t i=0; i<pages.size(); i++)
+        store(&index[8*i], pages[i], 8);
+    
+    struct iovec vectors[4]={
+        {header, sizeof(header)},
+        {index.data(), index.size()},
+        {const_cast<uint8_t *>(keys.data()), keys.size()},
+        {const_cast<uint8_t *>(values.data()), values.size()}
+    };
+    writer.writeGather(vectors, 4);
+}
+
+/******************************************************************************/
+
+_TableImage::_TableImage(const char * filename) : mapped(true) {
+    int fd=open(filename, O_RDONLY);
+    if (fd<0)
+        throw std::system_error(errno, std::generic_category());
+    struct stat status;
+    if (fstat(fd, &status)) {
+        int error=errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category());
+    }
+    length=status.st_size;
+    if (length<HEADER_SIZE) {
+        close(fd);
+        corrupted();
+    }
+    void * mapping=mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    int error=errno;
+    close(fd);
+    if (mapping==MAP_FAILED)
+        throw std::system_error(error, std::generic_category());
+    data=static_cast<const uint8_t *>(mapping);
+    try {
+        parse();
+    }
+    catch (...) {
+        munmap(mapping, length);
+        throw;
+    }
+}
+
+_TableImage::_TableImage(const void * data, size_t length) :
+        data(static_cast<const uint8_t *>(data)), length(length), mapped(false) {
+    parse();
+}
+
+_TableImage::~_TableImage() {
+    if (mapped)
+        munmap(const_cast<uint8_t *>(data), length);
+}
+
+size_t _TableImage::getPageOffset(size_t page) const {
+    uint64_t result=load(index+8*page, 8);
+    if (result>=keysLength)
+        corrupted();
+    return result;
+}
+
+ByteArrayReader _TableImage::readKeys(size_t offset) const {
+    return ByteArrayReader(keys+offset, keysLength-offset);
+}
+
+ByteArrayReader _TableImage::readValue(uint64_t offset) const {
+    if (offset>valuesLength)
+        corrupted();
+    return ByteArrayReader(values+offset, valuesLength-offset);
+}
+
+void _TableImage::parse() {
+    if (length<HEADER_SIZE||load(data, 4)!=MAGIC)
+        corrupted();
+    pageSize=load(data+4, 4);
+    count=load(data+8, 8);
+    nPages=load(data+16, 8);
+    uint64_t nKeys=load(data+24, 8), nValues=load(data+32, 8);
+    size_t space=length-HEADER_SIZE;
+    if (!pageSize||nPages!=count/pageSize+(count%pageSize!=0)||
+            nPages>space/8||nKeys>space-8*nPages||nValues>space-8*nPages-nKeys)
+        corrupted();
+    index=data+HEADER_SIZE;
+    keys=index+8*nPages;
+    keysLength=nKeys;
+    values=keys+keysLength;
+    valuesLength=nValues;
+}
@@ -0,0 +1,202 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Memory-mapped sorted tables
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_SORTEDTABLE_HPP
+#define __ROHAN_SORTEDTABLE_HPP
+
+#include <optional>
+#include <stdexcept>
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** Write the parts of a sorted table, use writeSortedTable() instead **/
+void _writeSortedTable(Writer &writer, uint64_t count, unsigned pageSize,
+        const std::vector<uint64_t> &pages, const std::vector<uint8_t> &keys,
+        const std::vector<uint8_t> &values);
+
+/** Write a map as a table for SortedTable. Keys are grouped into pages of
+    pageSize entries, each key is followed by the offset of its value; values
+    are stored after all the keys. **/
+template <class K, class V, class C>
+void writeSortedTable(Writer &writer, const std::map<K, V, C> &map,
+        unsigned pageSize=64) {
+    if (!pageSize)
+        throw std::invalid_argument("pageSize");
+    ByteArrayWriter keys, values;
+    std::vector<uint64_t> pages;
+    pages.reserve((map.size()+pageSize-1)/pageSize);
+    size_t i=0;
+    for (const auto &entry: map) {
+        if (i++%pageSize==0)
+            pages.push_back(keys.getBuffer().size());
+        keys | entry.first;
+        writeVariableInteger(keys, values.getBuffer().size());
+        values | entry.second;
+    }
+    _writeSortedTable(writer, map.size(), pageSize, pages, keys.getBuffer(),
+        values.getBuffer());
+}
+
+/** Sections of a sorted table in memory or in a mapped file **/
+class _TableImage {
+public:
+    /** Map a file **/
+    explicit _TableImage(const char * filename);
+    /** Use data in memory **/
+    _TableImage(const void * data, size_t length);
+    _TableImage(const _TableImage &)=delete;
+    _TableImage &operator =(const _TableImage &)=delete;
+    /** Unmap the file **/
+    ~_TableImage();
+    /** Returns the offset of the first key of a page **/
+    size_t getPageOffset(size_t page) const;
+    /** Returns a reader of keys starting from the offset **/
+    ByteArrayReader readKeys(size_t offset) const;
+    /** Returns a reader of the value at the offset **/
+    ByteArrayReader readValue(uint64_t offset) const;
+    
+    uint64_t count;
+    unsigned pageSize;
+    uint64_t nPages;
+    
+private:
+    void parse();
+    
+    const uint8_t * data;
+    size_t length;
+    bool mapped;
+    const uint8_t * index;
+    const uint8_t * keys;
+    size_t keysLength;
+    const uint8_t * values;
+    size_t valuesLength;
+};
+
+/** Read-only view of a table written by writeSortedTable(). The file is
+    mapped into memory and nothing is decoded when it is opened: a lookup
+    decodes the first keys of O(log(pages)) pages and the keys of a single
+    page, values are decoded only when they are requested. Comparator C must
+    order the keys in the same way as the comparator of the written map. **/
+template <class K, class V, class C=std::less<K>>
+class SortedTable {
+public:
+    /** Position in the table **/
+    class Iterator {
+    public:
+        /** Returns the key **/
+        const K &key() const { return *current; }
+        /** Decodes the value **/
+        V value() const {
+            ByteArrayReader reader=table->image.readValue(valueOffset);
+            return V(reader);
+        }
+        /** Move to the next entry **/
+        Iterator &operator ++() {
+            if (++index<table->image.count)
+                load(next);
+            else
+                current.reset();
+            return *this;
+        }
+        /**/
+        bool operator ==(const Iterator &other) const { return index==other.index; }
+        /**/
+        bool operator !=(const Iterator &other) const { return index!=other.index; }
+    
+    private:
+        friend class SortedTable;
+        
+        Iterator(const SortedTable * table, uint64_t index, size_t offset) :
+                table(table), index(index), next(0), valueOffset(0) {
+            if (index<table->image.count)
+                load(offset);
+        }
+        
+        void load(size_t offset) {
+            ByteArrayReader reader=table->image.readKeys(offset);
+            current.emplace(K(reader));
+            valueOffset=readVariableInteger(reader);
+            next=offset+reader.consumed();
+        }
+        
+        const SortedTable * table;
+        uint64_t index;
+        size_t next;
+        std::optional<K> current;
+        uint64_t valueOffset;
+    };
+    
+    /** Map a file **/
+    explicit SortedTable(const char * filename, const C &compare=C()) :
+            image(filename), compare(compare) {}
+    /** Use a table in memory, the data must outlive the object **/
+    SortedTable(const void * data, size_t length, const C &compare=C()) :
+            image(data, length), compare(compare) {}
+    /** Returns the number of entries **/
+    size_t size() const { return image.count; }
+    /** Returns true if the table has no entries **/
+    bool empty() const { return !image.count; }
+    /** Returns the first entry **/
+    Iterator begin() const { return page(0); }
+    /** Returns the position after the last entry **/
+    Iterator end() const { return Iterator(this, image.count, 0); }
+    /** Returns the first entry which is not less than the key **/
+    Iterator lowerBound(const K &key) const {
+        // Find the last page which starts with a key not greater than the key
+        uint64_t low=0, high=image.nPages;
+        while (low<high) {
+            uint64_t middle=low+(high-low)/2;
+            if (compare(key, page(middle).key()))
+                high=middle;
+            else
+                low=middle+1;
+        }
+        if (!low)
+            return begin();
+        Iterator result=page(low-1);
+        while (result!=end()&&compare(result.key(), key))
+            ++result;
+        return result;
+    }
+    /** Returns the entry with the key or end() **/
+    Iterator find(const K &key) const {
+        Iterator result=lowerBound(key);
+        return result!=end()&&!compare(key, result.key())?result:end();
+    }
+    /** Returns the value for the key, if there is one **/
+    std::optional<V> get(const K &key) const {
+        Iterator result=find(key);
+        return result!=end()?std::optional<V>(result.value()):std::nullopt;
+    }
+    /** Returns the range of string keys which start with the prefix **/
+    std::pair<Iterator, Iterator> findPrefix(const std::string &prefix) const {
+        static_assert(std::is_same_v<K, std::string>, "keys must be strings");
+        // The first string which is greater than all the strings with prefix
+        std::string limit=prefix;
+        while (!limit.empty()&&uint8_t(limit.back())==0xff)
+            limit.pop_back();
+        if (limit.empty())
+            return std::make_pair(lowerBound(prefix), end());
+        limit.back()=char(uint8_t(limit.back())+1);
+        return std::make_pair(lowerBound(prefix), lowerBound(limit));
+    }
+    
+private:
+    Iterator page(uint64_t number) const {
+        if (number>=image.nPages)
+            return end();
+        return Iterator(this, number*image.pageSize, image.getPageOffset(number));
+    }
+    
+    _TableImage image;
+    C compare;
+};
+
+}
+
+#endif
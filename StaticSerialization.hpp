@@ -0,0 +1,445 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Serialization with static dispatch to a concrete stream
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_STATICSERIALIZATION_HPP
+#define __ROHAN_STATICSERIALIZATION_HPP
+
+#include <cstring>
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/*******************************************************************************
+ *  Values are encoded and decoded by templates instantiated for a concrete
+ *  stream, so that calls to the stream are inlined. The encoding is the same
+ *  as of Writer and Reader. Values of other types are written and read
+ *  through an adapter to the abstract interface. String dictionaries and
+ *  shared objects tables do not apply to the static streams.
+ ******************************************************************************/
+
+/** Writer which forwards data to a static sink **/
+template <class S>
+class _WriterAdapter : public Writer {
+public:
+    explicit _WriterAdapter(S &sink) : sink(sink) {}
+    void write(const void * from, size_t length) override {
+        sink.write(from, length);
+    }
+    
+private:
+    S &sink;
+};
+
+/** Reader which takes data from a static source **/
+template <class S>
+class _ReaderAdapter : public Reader {
+public:
+    explicit _ReaderAdapter(S &source) : source(source) {
+        setLimits(source.getLimits());
+    }
+    size_t read(void * to, size_t length) override {
+        source.readFully(to, length);
+        return length;
+    }
+    size_t skip(size_t length) override {
+        source.skipFully(length);
+        return length;
+    }
+    
+private:
+    S &source;
+};
+
+/** Types which are stored as is and may be copied in bulk **/
+template <class T>
+constexpr bool _isStaticFixed() {
+    return std::is_same_v<T, bool>||std::is_floating_point_v<T>||
+        (std::is_integral_v<T>&&sizeof(T)==1);
+}
+
+/** Integer types which are written as variable integers without zigzag **/
+template <class T>
+constexpr bool _isStaticUnsigned() {
+    return std::is_same_v<T, wchar_t>||(std::is_unsigned_v<T>&&
+        !std::is_same_v<T, char16_t>&&!std::is_same_v<T, char32_t>);
+}
+
+/** Integer types which are written as zigzag variable integers **/
+template <class T>
+constexpr bool _isStaticSigned() {
+    return std::is_integral_v<T>&&std::is_signed_v<T>&&!std::is_same_v<T, wchar_t>;
+}
+
+/** Types which have template serialize() method **/
+template <class T, class S, class=void>
+struct _hasStaticSerialize : std::false_type {};
+
+template <class T, class S>
+struct _hasStaticSerialize<T, S, std::void_t<decltype(
+        std::declval<const T &>().serialize(std::declval<S &>()))>> : std::true_type {};
+
+template <class T>
+struct _isStaticArray : std::false_type {};
+
+template <class T, size_t n>
+struct _isStaticArray<std::array<T, n>> : std::true_type {};
+
+template <class T>
+struct _isStaticSequence : std::false_type {};
+
+template <class T>
+struct _isStaticSequence<std::vector<T>> : std::true_type {};
+
+template <class T>
+struct _isStaticSequence<std::list<T>> : std::true_type {};
+
+template <class T>
+struct _isStaticPair : std::false_type {};
+
+template <class X, class Y>
+struct _isStaticPair<std::pair<X, Y>> : std::true_type {};
+
+template <class T>
+struct _isStaticMap : std::false_type {};
+
+template <class K, class V>
+struct _isStaticMap<std::map<K, V>> : std::true_type {};
+
+template <class T>
+struct _isStaticSet : std::false_type {};
+
+template <class T>
+struct _isStaticSet<std::set<T>> : std::true_type {};
+
+template <class T>
+struct _isStaticUniquePointer : std::false_type {};
+
+template <class T>
+struct _isStaticUniquePointer<std::unique_ptr<T>> : std::true_type {};
+
+template <class S>
+inline void _encodeVariableInteger(S &sink, unsigned long long value) {
+    _ROHAN_COUNT(varints);
+    uint8_t buffer[MAX_VARIABLE_INTEGER_SIZE];
+    sink.write(buffer, encodeVariableInteger(value, buffer));
+}
+
+template <class S, class T>
+inline void _encode(S &sink, const T &value) {
+    if constexpr (_isStaticFixed<T>())
+        sink.write(&value, sizeof(value));
+    else if constexpr (std::is_enum_v<T>) {
+        uint8_t byte=uint8_t(value);
+        sink.write(&byte, sizeof(byte));
+    }
+    else if constexpr (_isStaticUnsigned<T>())
+        _encodeVariableInteger(sink, value);
+    else if constexpr (_isStaticSigned<T>())
+        _encodeVariableInteger(sink, _encodeZigzag<T>(value));
+    else if constexpr (std::is_array_v<T>||_isStaticArray<T>::value) {
+        for (const auto &element: value)
+            _encode(sink, element);
+    }
+    else if constexpr (std::is_same_v<T, std::string>) {
+        _ROHAN_COUNT(strings);
+        _encodeVariableInteger(sink, value.length());
+        sink.write(value.data(), value.length());
+    }
+    else if constexpr (std::is_same_v<T, std::wstring>) {
+        _ROHAN_COUNT(strings);
+        _encodeVariableInteger(sink, value.length());
+        for (wchar_t c: value)
+            _encodeVariableInteger(sink, c);
+    }
+    else if constexpr (_isStaticSequence<T>::value||_isStaticMap<T>::value) {
+        _ROHAN_COUNT(containers);
+        _encodeVariableInteger(sink, value.size());
+        using Element=typename T::value_type;
+        if constexpr (std::is_same_v<T, std::vector<Element>>&&
+                _isStaticFixed<Element>()&&!std::is_same_v<Element, bool>)
+            sink.write(value.data(), value.size()*sizeof(Element));
+        else {
+            for (const auto &element: value)
+                _encode(sink, element);
+        }
+    }
+    else if constexpr (_isStaticSet<T>::value) {
+        _ROHAN_COUNT(containers);
+        _encodeVariableInteger(sink, value.size());
+        using Element [[maybe_unused]]=typename T::value_type;
+#ifdef ROHAN_DELTA_SETS
+        if constexpr (std::is_integral_v<Element>&&!std::is_same_v<Element, bool>) {
+            uint64_t previous=0;
+            for (Element element: value) {
+                _encodeVariableInteger(sink, uint64_t(element)-previous);
+                previous=uint64_t(element);
+            }
+            return;
+        }
+#endif
+        for (const auto &element: value)
+            _encode(sink, element);
+    }
+    else if constexpr (_isStaticPair<T>::value) {
+        _encode(sink, value.first);
+        _encode(sink, value.second);
+    }
+    else if constexpr (_isStaticUniquePointer<T>::value) {
+        _encode(sink, bool(value));
+        if (value)
+            _encode(sink, *value);
+    }
+    else if constexpr (_hasStaticSerialize<T, S>::value)
+        value.serialize(sink);
+    else {
+        _WriterAdapter<S> adapter(sink);
+        adapter | value;
+    }
+}
+
+template <class S>
+inline unsigned long long _decodeVariableInteger(S &source) {
+    _ROHAN_COUNT(varints);
+    unsigned long long result=0;
+    uint8_t byte=0x80;
+    unsigned shift=0;
+    while (byte&0x80) {
+        if (shift>=64)
+            throw Malformed("variable integer is too long");
+        source.readFully(&byte, sizeof(byte));
+        result|=((unsigned long long)(byte&0x7f)<<shift);
+        shift+=7;
+    }
+    // The tenth byte holds the only remaining bit
+    if (shift==70&&byte>1)
+        throw Malformed("variable integer is too long");
+    return result;
+}
+
+template <class S>
+inline size_t _decodeLength(S &source) {
+    unsigned long long result=_decodeVariableInteger(source);
+    if (result>source.getLimits().maxLength)
+        throw Malformed("length exceeds the limit");
+    return result;
+}
+
+/** Read elements stored as is by pages, so that a corrupted length does not
+    cause a huge allocation **/
+template <class S, class C>
+inline void _decodeFixed(S &source, C &container, size_t length) {
+    const size_t PAGE_SIZE=4096;
+    using Element=typename C::value_type;
+    while (length>0) {
+        size_t portion=std::min(length, PAGE_SIZE);
+        size_t offset=container.size();
+        container.resize(offset+portion);
+        source.readFully(&container[offset], portion*sizeof(Element));
+        length-=portion;
+    }
+}
+
+template <class T, class S>
+inline T _decode(S &source) {
+    if constexpr (std::is_same_v<T, bool>) {
+        // Any byte is a valid boolean value
+        uint8_t result;
+        source.readFully(&result, sizeof(result));
+        return result!=0;
+    }
+    else if constexpr (_isStaticFixed<T>()) {
+        T result;
+        source.readFully(&result, sizeof(result));
+        return result;
+    }
+    else if constexpr (std::is_enum_v<T>)
+        return T(_decode<uint8_t>(source));
+    else if constexpr (_isStaticUnsigned<T>())
+        return static_cast<T>(_decodeVariableInteger(source));
+    else if constexpr (_isStaticSigned<T>())
+        return _decodeZigzag<T>(_decodeVariableInteger(source));
+    else if constexpr (_isStaticArray<T>::value) {
+        T result;
+        for (auto &element: result)
+            element=_decode<typename T::value_type>(source);
+        return result;
+    }
+    else if constexpr (std::is_same_v<T, std::string>) {
+        _ROHAN_COUNT(strings);
+        std::string result;
+        _decodeFixed(source, result, _decodeLength(source));
+        return result;
+    }
+    else if constexpr (std::is_same_v<T, std::wstring>) {
+        _ROHAN_COUNT(strings);
+        std::wstring result;
+        size_t length=_decodeLength(source);
+        result.reserve(std::min(length, size_t(4096)));
+        while (length-->0)
+            result.push_back(_decode<wchar_t>(source));
+        return result;
+    }
+    else if constexpr (_isStaticSequence<T>::value) {
+        _ROHAN_COUNT(containers);
+        using Element=typename T::value_type;
+        T result;
+        size_t length=_decodeLength(source);
+        if constexpr (std::is_same_v<T, std::vector<Element>>&&
+                _isStaticFixed<Element>()&&!std::is_same_v<Element, bool>)
+            _decodeFixed(source, result, length);
+        else {
+            while (length-->0)
+                result.push_back(_decode<Element>(source));
+        }
+        return result;
+    }
+    else if constexpr (_isStaticMap<T>::value) {
+        _ROHAN_COUNT(containers);
+        T result;
+        size_t length=_decodeLength(source);
+        while (length-->0) {
+            auto key=_decode<typename T::key_type>(source);
+            result.emplace_hint(result.end(), std::move(key),
+                _decode<typename T::mapped_type>(source));
+        }
+        return result;
+    }
+    else if constexpr (_isStaticSet<T>::value) {
+        _ROHAN_COUNT(containers);
+        using Element=typename T::value_type;
+        T result;
+        size_t length=_decodeLength(source);
+#ifdef ROHAN_DELTA_SETS
+        if constexpr (std::is_integral_v<Element>&&!std::is_same_v<Element, bool>) {
+            uint64_t previous=0;
+            while (length-->0) {
+                previous+=_decodeVariableInteger(source);
+                result.emplace_hint(result.end(), Element(previous));
+            }
+            return result;
+        }
+#endif
+        while (length-->0)
+            result.emplace_hint(result.end(), _decode<Element>(source));
+        return result;
+    }
+    else if constexpr (_isStaticPair<T>::value) {
+        auto first=_decode<typename T::first_type>(source);
+        return T(std::move(first), _decode<typename T::second_type>(source));
+    }
+    else if constexpr (_isStaticUniquePointer<T>::value) {
+        using Element=typename T::element_type;
+        if (!_decode<bool>(source))
+            return nullptr;
+        return std::make_unique<Element>(_decode<Element>(source));
+    }
+    else {
+        _ReaderAdapter<S> adapter(source);
+        return T(adapter);
+    }
+}
+
+/** Base class of static sinks. Derived class D must have a non-virtual
+    method write(const void *, size_t). **/
+template <class D>
+class StaticWriter {
+public:
+    /** Serialize a value **/
+    template <class T>
+    D &operator |(const T &value) {
+        _encode(static_cast<D &>(*this), value);
+        return static_cast<D &>(*this);
+    }
+    /** Write one or more values at once **/
+    template <class... A>
+    void put(const A &... values) {
+        (*this | ... | values);
+    }
+};
+
+/** Base class of static sources. Derived class D must have non-virtual
+    methods readFully(void *, size_t) and skipFully(size_t). **/
+template <class D>
+class StaticReader {
+public:
+    /** Unserialize a value using "type conversion" style **/
+    template <class T>
+    explicit operator T() {
+        return _decode<T>(static_cast<D &>(*this));
+    }
+    /** Read one or more values **/
+    template <class... A>
+    void get(A &... values) {
+        ((values=_decode<A>(static_cast<D &>(*this))), ...);
+    }
+    /** Returns the limits **/
+    const Limits &getLimits() const { return limits; }
+    /** Set the limits **/
+    void setLimits(const Limits &limits) { this->limits=limits; }
+    
+private:
+    Limits limits;
+};
+
+/** Static sink which appends data to a byte array **/
+class StaticByteArrayWriter : public StaticWriter<StaticByteArrayWriter> {
+public:
+    /** Create a writer **/
+    explicit StaticByteArrayWriter(size_t capacity=0) {
+        buffer.reserve(capacity);
+    }
+    /** Returns the underlying byte array **/
+    const std::vector<uint8_t> &getBuffer() const { return buffer; }
+    /** Discard written data keeping the memory **/
+    void clear() { buffer.clear(); }
+    /** Write a portion of data **/
+    void write(const void * from, size_t length) {
+        size_t size=buffer.size();
+        buffer.resize(size+length);
+        if (length)
+            memcpy(buffer.data()+size, from, length);
+    }
+    
+private:
+    std::vector<uint8_t> buffer;
+};
+
+/** Static source which reads data from memory **/
+class StaticByteArrayReader : public StaticReader<StaticByteArrayReader> {
+public:
+    /** Initialize from pointer and length **/
+    StaticByteArrayReader(const void * data, size_t length) :
+            data(static_cast<const uint8_t *>(data)), end(this->data+length) {}
+    /** Initialize from byte array **/
+    explicit StaticByteArrayReader(const std::vector<uint8_t> &buffer) :
+            StaticByteArrayReader(buffer.data(), buffer.size()) {}
+    /** Returns the number of bytes that can be read **/
+    size_t available() const { return end-data; }
+    /** Read a portion of data, throw End() if could not be read completely **/
+    void readFully(void * to, size_t length) {
+        if (length>available())
+            throw End();
+        if (length)
+            memcpy(to, data, length);
+        data+=length;
+    }
+    /** Skip a portion of data, throw End() if could not be skipped completely **/
+    void skipFully(size_t length) {
+        if (length>available())
+            throw End();
+        data+=length;
+    }
+    
+private:
+    const uint8_t * data;
+    const uint8_t * end;
+};
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Counters of encoded and decoded values
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_STATISTICS_HPP
+#define __ROHAN_STATISTICS_HPP
+
+#include <cstdint>
+
+namespace rohan {
+
+/** Numbers of values written and read by the current thread. The counters
+    are updated only if the library and the program are compiled with
+    ROHAN_STATISTICS defined, otherwise they cost nothing. **/
+struct Statistics {
+    /** Variable-length integers, including lengths of strings and containers **/
+    uint64_t varints=0;
+    /** Strings **/
+    uint64_t strings=0;
+    /** Containers **/
+    uint64_t containers=0;
+};
+
+inline thread_local Statistics _statistics;
+
+/** Returns the counters of the current thread **/
+inline Statistics getStatistics() {
+    return _statistics;
+}
+
+/** Reset the counters of the current thread **/
+inline void resetStatistics() {
+    _statistics=Statistics();
+}
+
+}
+
+#ifdef ROHAN_STATISTICS
+#define _ROHAN_COUNT(counter) (++rohan::_statistics.counter)
+#else
+#define _ROHAN_COUNT(counter) ((void)0)
+#endif
+
+#endif
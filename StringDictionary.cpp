@@ -0,0 +1,99 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Deduplication of repeated strings
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <stdexcept>
+#include "StringDictionary.hpp"
+
+namespace rohan {
+
+/******************************************************************************/
+
+ROHAN_INLINE StringDictionary::StringDictionary(size_t maxSize) : maxSize(maxSize) {}
+
+ROHAN_INLINE const std::string &StringDictionary::get(size_t index) const {
+    if (index>=strings.size())
+        throw Malformed("unknown string reference");
+    return strings[index];
+}
+
+ROHAN_INLINE size_t StringDictionary::find(std::string_view string) const {
+    auto i=index.find(string);
+    return i!=index.end()?i->second:npos;
+}
+
+ROHAN_INLINE void StringDictionary::add(std::string_view string) {
+    if (!full()) {
+        // Keys refer to the strings kept in the deque, which never moves them
+        strings.emplace_back(string);
+        index.emplace(strings.back(), strings.size()-1);
+    }
+}
+
+ROHAN_INLINE const std::string &StringDictionary::append(const std::string &string) {
+    if (full())
+        throw std::logic_error("dictionary is full");
+    strings.push_back(string);
+    return strings.back();
+}
+
+ROHAN_INLINE void StringDictionary::clear() {
+    index.clear();
+    strings.clear();
+}
+
+/******************************************************************************/
+
+ROHAN_INLINE bool writeDictionaryString(Writer &stream, const char * string,
+        size_t length) {
+    StringDictionary &dictionary=*stream.getDictionary();
+    size_t id=dictionary.find(std::string_view(string, length));
+    if (id!=StringDictionary::npos) {
+        writeVariableInteger(stream, id+1);
+        return true;
+    }
+    else {
+        writeVariableInteger(stream, 0);
+        dictionary.add(std::string_view(string, length));
+        return false;
+    }
+}
+
+ROHAN_INLINE const std::string * readDictionaryString(Reader &stream) {
+    size_t id=readVariableInteger(stream);
+    return id?&stream.getDictionary()->get(id-1):nullptr;
+}
+
+ROHAN_INLINE void addDictionaryString(Reader &stream, const std::string &string) {
+    StringDictionary &dictionary=*stream.getDictionary();
+    if (!dictionary.full())
+        dictionary.append(string);
+}
+
+/******************************************************************************/
+
+ROHAN_INLINE InternedString::InternedString(Reader &reader) {
+    StringDictionary * dictionary=reader.getDictionary();
+    if (!dictionary)
+        throw std::logic_error("reader has no dictionary");
+    string=readDictionaryString(reader);
+    if (!string) {
+        // Read the new string without the dictionary
+        reader.setDictionary(nullptr);
+        try {
+            value=std::string(reader);
+        }
+        catch (...) {
+            reader.setDictionary(dictionary);
+            throw;
+        }
+        reader.setDictionary(dictionary);
+        if (!dictionary->full())
+            string=&dictionary->append(value);
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Deduplication of repeated strings
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_STRINGDICTIONARY_HPP
+#define __ROHAN_STRINGDICTIONARY_HPP
+
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Table of strings which were already written or read. When a dictionary is
+    set to a writer, every std::string or C string is written as a varint:
+    0 is followed by a new string, n refers to the n-th known string. The
+    reader must use a dictionary with the same limit. **/
+class StringDictionary {
+public:
+    /** Value returned by find() if the string is not known **/
+    static const size_t npos=size_t(-1);
+    
+    /** Create a dictionary, which keeps up to maxSize strings **/
+    explicit StringDictionary(size_t maxSize=npos);
+    /** Returns the number of strings **/
+    size_t size() const { return strings.size(); }
+    /** Returns true if no more strings can be added **/
+    bool full() const { return strings.size()>=maxSize; }
+    /** Returns a known string by its index **/
+    const std::string &get(size_t index) const;
+    /** Returns index of a string or npos **/
+    size_t find(std::string_view string) const;
+    /** Add a string and index it for find() (writer side) **/
+    void add(std::string_view string);
+    /** Add a string without indexing (reader side), returns the stored copy **/
+    const std::string &append(const std::string &string);
+    /** Forget all strings **/
+    void clear();
+    
+private:
+    size_t maxSize;
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, size_t> index;
+};
+
+/** String which is read into the dictionary and shared by all occurrences,
+    the dictionary must outlive the object. If the dictionary is full, the
+    string is kept in the object itself. **/
+class InternedString {
+public:
+    /** Read a string, the reader must have a dictionary **/
+    explicit InternedString(Reader &reader);
+    /** Returns the string **/
+    const std::string &get() const { return string?*string:value; }
+    /** Returns the string **/
+    operator const std::string &() const { return get(); }
+    
+private:
+    const std::string * string;
+    std::string value;
+};
+
+}
+
+#ifdef ROHAN_HEADER_ONLY
+#include "StringDictionary.cpp"
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Tagged fields for schema evolution
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include "TaggedSerialization.hpp"
+
+using namespace rohan;
+
+/******************************************************************************/
+
+bool TaggedReader::find(unsigned id, WireType type) {
+    for (;;) {
+        if (!pending) {
+            key=readVariableInteger(reader);
+            pending=true;
+        }
+        uint64_t current=key>>3;
+        if (!key||current>id) {
+            // End of fields, or the field is absent
+            return false;
+        }
+        else if (current==id) {
+            if ((key&7)!=type)
+                throw Malformed("field has another wire type");
+            return true;
+        }
+        else {
+            // Unknown field
+            skip();
+            pending=false;
+        }
+    }
+}
+
+void TaggedReader::skip() {
+    switch (key&7) {
+    case WIRE_VARINT:
+        while (uint8_t(reader)&0x80);
+        break;
+    case WIRE_FIXED8:
+        reader.skipFully(1);
+        break;
+    case WIRE_FIXED32:
+        reader.skipFully(4);
+        break;
+    case WIRE_FIXED64:
+        reader.skipFully(8);
+        break;
+    case WIRE_LENGTH:
+        reader.skipFully(readVariableInteger(reader));
+        break;
+    default:
+        throw Malformed("unknown wire type");
+    }
+}
+
+void TaggedReader::end() {
+    for (;;) {
+        if (!pending)
+            key=readVariableInteger(reader);
+        pending=false;
+        if (!key)
+            break;
+        skip();
+    }
+}
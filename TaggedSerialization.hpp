@@ -0,0 +1,114 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Tagged fields for schema evolution
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_TAGGEDSERIALIZATION_HPP
+#define __ROHAN_TAGGEDSERIALIZATION_HPP
+
+#include <stdexcept>
+#include "ByteArraySerialization.hpp"
+
+namespace rohan {
+
+/** How a field value is encoded, so that unknown fields can be skipped **/
+enum WireType : uint8_t {
+    WIRE_VARINT, WIRE_FIXED8, WIRE_FIXED32, WIRE_FIXED64, WIRE_LENGTH
+};
+
+/** Returns the wire type of a field of type T **/
+template <class T>
+constexpr WireType _getWireType() {
+    if constexpr (std::is_enum_v<T>||std::is_same_v<T, bool>||(sizeof(T)==1&&std::is_integral_v<T>))
+        return WIRE_FIXED8;
+    else if constexpr (std::is_integral_v<T>)
+        return WIRE_VARINT;
+    else if constexpr (std::is_same_v<T, float>)
+        return WIRE_FIXED32;
+    else if constexpr (std::is_same_v<T, double>)
+        return WIRE_FIXED64;
+    else
+        return WIRE_LENGTH;
+}
+
+/** Writes fields with their identifiers and wire types. Identifiers must be
+    positive and ascending. Values of other types than integers and floating
+    point numbers are prefixed with the length, string dictionary and shared
+    objects tables do not apply to them. **/
+class TaggedWriter {
+public:
+    /** Start writing fields **/
+    explicit TaggedWriter(Writer &writer) : writer(writer) {}
+    /** Write a field, throws std::invalid_argument if the identifier is 0 **/
+    template <class T>
+    TaggedWriter &field(unsigned id, const T &value) {
+        // Key 0 marks the end of fields
+        if (!id)
+            throw std::invalid_argument("field identifier must be positive");
+        constexpr WireType type=_getWireType<T>();
+        writeVariableInteger(writer, (uint64_t(id)<<3)|type);
+        if constexpr (type==WIRE_LENGTH) {
+            ByteArrayWriter encoded;
+            encoded | value;
+            const std::vector<uint8_t> &buffer=encoded.getBuffer();
+            writeVariableInteger(writer, buffer.size());
+            writer.write(buffer.data(), buffer.size());
+        }
+        else
+            writer | value;
+        return *this;
+    }
+    /** Finish writing fields **/
+    void end() {
+        writeVariableInteger(writer, 0);
+    }
+    
+private:
+    Writer &writer;
+};
+
+/** Reads fields written by TaggedWriter. Fields must be requested in the
+    order of ascending identifiers; unknown fields are skipped. **/
+class TaggedReader {
+public:
+    /** Start reading fields **/
+    explicit TaggedReader(Reader &reader) : reader(reader), key(0), pending(false) {}
+    /** Read a field, returns defaultValue if the field is absent **/
+    template <class T>
+    T field(unsigned id, T defaultValue=T()) {
+        constexpr WireType type=_getWireType<T>();
+        if (!find(id, type))
+            return defaultValue;
+        pending=false;
+        if constexpr (type==WIRE_LENGTH) {
+            size_t length=readLength(reader);
+            const void * data=reader.borrow(length);
+            if (!data) {
+                readPaged(reader, buffer, length);
+                data=buffer.data();
+            }
+            ByteArrayReader value(data, length);
+            value.setLimits(reader.getLimits());
+            return T(value);
+        }
+        else
+            return T(reader);
+    }
+    /** Skip the remaining fields **/
+    void end();
+    
+private:
+    bool find(unsigned id, WireType type);
+    void skip();
+    
+    Reader &reader;
+    uint64_t key;
+    bool pending;
+    std::vector<uint8_t> buffer;
+};
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  UTF-8 encoding of wide strings
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "Utf8Serialization.hpp"
+
+using namespace rohan;
+using std::basic_string;
+using std::vector;
+
+/******************************************************************************/
+
+namespace {
+
+/** Buffers larger than this are freed after use **/
+const size_t MAX_RETAINED=1<<20;
+
+thread_local vector<uint8_t> buffer;
+
+/** Frees the buffer of the thread if it grew too large **/
+class BufferGuard {
+public:
+    ~BufferGuard() {
+        if (buffer.capacity()>MAX_RETAINED)
+            vector<uint8_t>().swap(buffer);
+    }
+};
+
+[[noreturn]] void invalidString() {
+    throw std::invalid_argument("string is not valid Unicode");
+}
+
+[[noreturn]] void invalidData() {
+    throw Malformed("invalid UTF-8 sequence");
+}
+
+/** Convert leading ASCII characters, returns their number **/
+template <class C>
+size_t encodeAscii(const C * from, size_t length, uint8_t * to) {
+    size_t i=0;
+#if defined(__SSE2__)
+    const __m128i zero=_mm_setzero_si128();
+    if constexpr (sizeof(C)==4) {
+        const __m128i high=_mm_set1_epi32(~0x7f);
+        for (; i+16<=length; i+=16) {
+            const __m128i * units=reinterpret_cast<const __m128i *>(from+i);
+            __m128i a=_mm_loadu_si128(units), b=_mm_loadu_si128(units+1);
+            __m128i c=_mm_loadu_si128(units+2), d=_mm_loadu_si128(units+3);
+            __m128i any=_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, high), zero))!=0xffff)
+                break;
+            __m128i bytes=_mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(to+i), bytes);
+        }
+    }
+    else {
+        const __m128i high=_mm_set1_epi16(short(0xff80));
+        for (; i+16<=length; i+=16) {
+            const __m128i * units=reinterpret_cast<const __m128i *>(from+i);
+            __m128i a=_mm_loadu_si128(units), b=_mm_loadu_si128(units+1);
+            __m128i any=_mm_or_si128(a, b);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(any, high), zero))!=0xffff)
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(to+i), _mm_packus_epi16(a, b));
+        }
+    }
+#endif
+    for (; i<length&&uint32_t(from[i])<0x80; i++)
+        to[i]=uint8_t(from[i]);
+    return i;
+}
+
+/** Convert UTF-16 or UTF-32 into UTF-8, the output must have room for four
+    bytes per code unit. Returns the number of bytes. **/
+template <class C>
+size_t encode(const C * from, size_t length, uint8_t * to) {
+    uint8_t * out=to;
+    size_t i=0;
+    while (i<length) {
+        uint32_t c=uint32_t(from[i]);
+        if (c<0x80) {
+            size_t n=encodeAscii(from+i, length-i, out);
+            i+=n;
+            out+=n;
+            continue;
+        }
+        i++;
+        if constexpr (sizeof(C)==2) {
+            c&=0xffff;
+            if (c>=0xd800&&c<0xdc00) {
+                uint32_t low=i<length?uint32_t(from[i])&0xffff:0;
+                if (low<0xdc00||low>=0xe000)
+                    invalidString();
+                c=0x10000+((c-0xd800)<<10)+(low-0xdc00);
+                i++;
+            }
+        }
+        if (c<0x800) {
+            *out++=0xc0|(c>>6);
+            *out++=0x80|(c&0x3f);
+        }
+        else if (c<0x10000) {
+            if (c>=0xd800&&c<0xe000)
+                invalidString();
+            *out++=0xe0|(c>>12);
+            *out++=0x80|((c>>6)&0x3f);
+            *out++=0x80|(c&0x3f);
+        }
+        else if (c<0x110000) {
+            *out++=0xf0|(c>>18);
+            *out++=0x80|((c>>12)&0x3f);
+            *out++=0x80|((c>>6)&0x3f);
+            *out++=0x80|(c&0x3f);
+        }
+        else
+            invalidString();
+    }
+    return out-to;
+}
+
+/** Convert leading ASCII bytes, returns their number **/
+template <class C>
+size_t decodeAscii(const uint8_t * from, size_t length, C * to) {
+    size_t i=0;
+#if defined(__SSE2__)
+    const __m128i zero=_mm_setzero_si128();
+    for (; i+16<=length; i+=16) {
+        __m128i bytes=_mm_loadu_si128(reinterpret_cast<const __m128i *>(from+i));
+        if (_mm_movemask_epi8(bytes))
+            break;
+        __m128i low=_mm_unpacklo_epi8(bytes, zero), high=_mm_unpackhi_epi8(bytes, zero);
+        __m128i * units=reinterpret_cast<__m128i *>(to+i);
+        if constexpr (sizeof(C)==4) {
+            _mm_storeu_si128(units, _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128(units+1, _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128(units+2, _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128(units+3, _mm_unpackhi_epi16(high, zero));
+        }
+        else {
+            _mm_storeu_si128(units, low);
+            _mm_storeu_si128(units+1, high);
+        }
+    }
+#endif
+    for (; i<length&&from[i]<0x80; i++)
+        to[i]=from[i];
+    return i;
+}
+
+/** Convert UTF-8 into UTF-16 or UTF-32, the output must have room for one
+    code unit per byte. Returns the number of code units. **/
+template <class C>
+size_t decode(const uint8_t * from, size_t length, C * to) {
+    C * out=to;
+    size_t i=0;
+    while (i<length) {
+        uint8_t lead=from[i];
+        if (lead<0x80) {
+            size_t n=decodeAscii(from+i, length-i, out);
+            i+=n;
+            out+=n;
+            continue;
+        }
+        size_t n;
+        uint32_t c, min;
+        if ((lead&0xe0)==0xc0) {
+            n=2;
+            c=lead&0x1f;
+            min=0x80;
+        }
+        else if ((lead&0xf0)==0xe0) {
+            n=3;
+            c=lead&0x0f;
+            min=0x800;
+        }
+        else if ((lead&0xf8)==0xf0) {
+            n=4;
+            c=lead&0x07;
+            min=0x10000;
+        }
+        else
+            invalidData();
+        if (length-i<n)
+            invalidData();
+        for (size_t k=1; k<n; k++) {
+            uint8_t trail=from[i+k];
+            if ((trail&0xc0)!=0x80)
+                invalidData();
+            c=(c<<6)|(trail&0x3f);
+        }
+        // Overlong sequences, surrogates and too large code points
+        if (c<min||c>0x10ffff||(c>=0xd800&&c<0xe000))
+            invalidData();
+        i+=n;
+        if constexpr (sizeof(C)==2) {
+            if (c>=0x10000) {
+                c-=0x10000;
+                *out++=C(0xd800+(c>>10));
+                *out++=C(0xdc00+(c&0x3ff));
+                continue;
+            }
+        }
+        *out++=C(c);
+    }
+    return out-to;
+}
+
+template <class C>
+void writeString(Writer &writer, const C * string, size_t length) {
+    _ROHAN_COUNT(strings);
+    BufferGuard guard;
+    if (buffer.size()<4*length)
+        buffer.resize(4*length);
+    size_t size=encode(string, length, buffer.data());
+    writeVariableInteger(writer, size);
+    if (size)
+        writer.write(buffer.data(), size);
+}
+
+}
+
+/******************************************************************************/
+
+void rohan::writeUtf8(Writer &writer, const wchar_t * string, size_t length) {
+    writeString(writer, string, length);
+}
+
+void rohan::writeUtf8(Writer &writer, const char16_t * string, size_t length) {
+    writeString(writer, string, length);
+}
+
+void rohan::writeUtf8(Writer &writer, const char32_t * string, size_t length) {
+    writeString(writer, string, length);
+}
+
+template <class C>
+basic_string<C> rohan::readUtf8(Reader &reader) {
+    _ROHAN_COUNT(strings);
+    size_t size=readLength(reader);
+    const uint8_t * data=static_cast<const uint8_t *>(reader.borrow(size));
+    BufferGuard guard;
+    if (!data) {
+        readPaged(reader, buffer, size);
+        data=buffer.data();
+    }
+    basic_string<C> result(size, C());
+    result.resize(decode(data, size, &result[0]));
+    return result;
+}
+
+template basic_string<wchar_t> rohan::readUtf8(Reader &reader);
+template basic_string<char16_t> rohan::readUtf8(Reader &reader);
+template basic_string<char32_t> rohan::readUtf8(Reader &reader);
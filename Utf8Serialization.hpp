@@ -0,0 +1,58 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  UTF-8 encoding of wide strings
+ *
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_UTF8SERIALIZATION_HPP
+#define __ROHAN_UTF8SERIALIZATION_HPP
+
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace rohan {
+
+/** Write the number of bytes and a string in UTF-8. Throws
+    std::invalid_argument if the string is not valid UTF-16 or UTF-32. **/
+void writeUtf8(Writer &writer, const wchar_t * string, size_t length);
+
+/** Write the number of bytes and a string in UTF-8 **/
+void writeUtf8(Writer &writer, const char16_t * string, size_t length);
+
+/** Write the number of bytes and a string in UTF-8 **/
+void writeUtf8(Writer &writer, const char32_t * string, size_t length);
+
+/** Read a string written by writeUtf8(), throws Malformed if the data are
+    not valid UTF-8. C is wchar_t, char16_t or char32_t. **/
+template <class C>
+std::basic_string<C> readUtf8(Reader &reader);
+
+/** String of wide characters written in UTF-8 instead of a variable integer
+    per character. ASCII text is transcoded with SIMD instructions. **/
+template <class S>
+class Utf8 {
+public:
+    using Char=typename S::value_type;
+    
+    /** Wrap a string for writing **/
+    explicit Utf8(const S &string) : reference(&string) {}
+    /** Read a string **/
+    explicit Utf8(Reader &reader) : value(readUtf8<Char>(reader)), reference(nullptr) {}
+    /** Returns the string **/
+    const S &get() const { return reference?*reference:value; }
+    /** Returns the string **/
+    operator const S &() const { return get(); }
+    /** Write the string **/
+    void serialize(Writer &writer) const {
+        writeUtf8(writer, get().data(), get().length());
+    }
+    
+private:
+    S value;
+    const S * reference;
+};
+
+}
+
+#endif
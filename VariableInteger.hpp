@@ -0,0 +1,70 @@
+/*******************************************************************************
+ *  Rohan data serialization library.
+ *  Encoding of variable-length integers
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#ifndef __ROHAN_VARIABLEINTEGER_HPP
+#define __ROHAN_VARIABLEINTEGER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/** Functions of the library core are defined in the headers and the library
+    need not be linked if ROHAN_HEADER_ONLY is defined **/
+#ifdef ROHAN_HEADER_ONLY
+#define ROHAN_INLINE inline
+#else
+#define ROHAN_INLINE
+#endif
+
+namespace rohan {
+
+/** Maximal number of bytes of a 64-bit variable integer **/
+const size_t MAX_VARIABLE_INTEGER_SIZE=10;
+
+/** Returns the number of bytes of a variable integer **/
+constexpr size_t getVariableIntegerSize(uint64_t value) {
+    size_t result=1;
+    for (; value>=0x80; value>>=7)
+        result++;
+    return result;
+}
+
+/** Encode a variable integer into at most MAX_VARIABLE_INTEGER_SIZE bytes,
+    returns the number of bytes **/
+constexpr size_t encodeVariableInteger(uint64_t value, uint8_t * to) {
+    size_t length=0;
+    for (; value>=0x80; value>>=7)
+        to[length++]=0x80|(0x7f&value);
+    to[length++]=value;
+    return length;
+}
+
+/** Returns a variable integer encoded at compile time **/
+template <uint64_t value>
+constexpr std::array<uint8_t, getVariableIntegerSize(value)> encodeVariableInteger() {
+    std::array<uint8_t, getVariableIntegerSize(value)> result {};
+    encodeVariableInteger(value, &result[0]);
+    return result;
+}
+
+template <class T>
+constexpr typename std::make_unsigned<T>::type _encodeZigzag(T value) {
+    typename std::make_unsigned<T>::type vshift=value;
+    vshift<<=1;
+    return value>=0?vshift:~vshift;
+}
+
+template <class T>
+constexpr T _decodeZigzag(T value) {
+    typename std::make_unsigned<T>::type _value=value;
+    return (_value>>1)^-(_value&1);
+}
+
+}
+
+#endif
@@ -9,12 +9,18 @@
 
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <cwchar>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <type_traits>
 #include <vector>
+#include <sys/uio.h>
+#include "Statistics.hpp"
+#include "VariableInteger.hpp"
 
 namespace rohan {
 
@@ -23,6 +29,9 @@ inline uint16_t operator ""_s(unsigned long long int value) { return value; }
 inline uint32_t operator ""_u(unsigned long long int value) { return value; }
 inline uint64_t operator ""_l(unsigned long long int value) { return value; }
 
+class ReferenceTable;
+class StringDictionary;
+
 /** Abstract data sink **/
 class Writer {
 public:
@@ -30,27 +39,56 @@ public:
     virtual ~Writer() {}
     /** Write a portion of data **/
     virtual void write(const void * from, size_t length)=0;
+    /** Write several portions of data at once (gather write) **/
+    virtual void writeGather(const struct iovec * vectors, size_t count) {
+        for (size_t i=0; i<count; i++)
+            write(vectors[i].iov_base, vectors[i].iov_len);
+    }
+    /** Write out any data kept by the writer itself **/
+    virtual void flush() {}
     /** Write one or more values at once **/
     template <class T, class... A>
     void put(T&& first, A&&... rest) {
         *this | first;
         put(rest...);
     }
+    /** Returns the dictionary used to deduplicate strings or nullptr **/
+    StringDictionary * getDictionary() const { return dictionary; }
+    /** Deduplicate strings with the dictionary, nullptr turns it off **/
+    void setDictionary(StringDictionary * dictionary) { this->dictionary=dictionary; }
+    /** Returns the table used to track shared objects or nullptr **/
+    ReferenceTable * getReferences() const { return references; }
+    /** Write shared objects once and then refer to them, nullptr turns it off **/
+    void setReferences(ReferenceTable * references) { this->references=references; }
     
 private:
     void put() {}
+    
+    StringDictionary * dictionary=nullptr;
+    ReferenceTable * references=nullptr;
 };
 
-void writeVariableInteger(Writer &stream, unsigned long long value);
-
-void writeSignedVariableInteger(Writer &stream, signed long long value);
+inline void writeVariableInteger(Writer &stream, unsigned long long value) {
+    _ROHAN_COUNT(varints);
+    uint8_t buffer[MAX_VARIABLE_INTEGER_SIZE];
+    stream.write(buffer, encodeVariableInteger(value, buffer));
+}
 
-template <class T>
-inline typename std::make_unsigned<T>::type _encodeZigzag(T value) {
-    T vshift=value<<1;
-    return value>=0?vshift:vshift^(T(-1));
+inline void writeSignedVariableInteger(Writer &stream, signed long long value) {
+    writeVariableInteger(stream, value>=0?(value<<1):(value<<1)^(~0));
 }
 
+/** Write a reference to a known string and return true, or mark the string as
+    new and return false, then the string itself must be written **/
+ROHAN_INLINE bool writeDictionaryString(Writer &stream, const char * string, size_t length);
+
+/** Write a reference to an already written object and return true, or mark
+    the object as new and return false, then the object must be written **/
+ROHAN_INLINE bool writeSharedObject(Writer &stream, const std::shared_ptr<const void> &object);
+
+/** Tell that a new shared object is completely written **/
+ROHAN_INLINE void finishSharedObject(Writer &stream, const void * object);
+
 #define _W_FIXED(T) \
     inline Writer &operator |(Writer &stream, const T &value) { \
         stream.write(&value, sizeof(value)); \
@@ -88,7 +126,7 @@ _W_FIXED(float)
 _W_FIXED(double)
 _W_FIXED(long double)
 
-template <class T, class = decltype(&T::serialize)>
+template <class T, class = decltype(std::declval<const T &>().serialize(std::declval<Writer &>()))>
 inline Writer &operator |(Writer &stream, const T &value) {
     value.serialize(stream);
     return stream;
@@ -110,7 +148,12 @@ Writer &operator |(Writer &stream, const std::array<T, n> &value) {
 
 template <class T>
 Writer &operator |(Writer &stream, const std::basic_string<T> &string) {
+    _ROHAN_COUNT(strings);
     size_t length=string.length();
+    if constexpr (std::is_same_v<T, char>) {
+        if (stream.getDictionary()&&writeDictionaryString(stream, string.data(), length))
+            return stream;
+    }
     writeVariableInteger(stream, length);
     for (size_t i=0; i<length; i++)
         stream | string[i];
@@ -119,6 +162,7 @@ Writer &operator |(Writer &stream, const std::basic_string<T> &string) {
 
 template <class T>
 Writer &operator |(Writer &stream, const std::list<T> &list) {
+    _ROHAN_COUNT(containers);
     size_t length=list.size();
     writeVariableInteger(stream, length);
     for (auto i=list.begin(); i!=list.end(); ++i)
@@ -128,6 +172,7 @@ Writer &operator |(Writer &stream, const std::list<T> &list) {
 
 template <class T>
 Writer &operator |(Writer &stream, const std::vector<T> &vector) {
+    _ROHAN_COUNT(containers);
     size_t length=vector.size();
     writeVariableInteger(stream, length);
     for (size_t i=0; i<length; i++)
@@ -142,6 +187,7 @@ Writer &operator |(Writer &stream, const std::pair<X, Y> &value) {
 
 template <class K, class V>
 Writer &operator |(Writer &stream, const std::map<K, V> &map) {
+    _ROHAN_COUNT(containers);
     writeVariableInteger(stream, map.size());
     for (auto i=map.begin(); i!=map.end(); ++i)
         stream | *i;
@@ -150,22 +196,73 @@ Writer &operator |(Writer &stream, const std::map<K, V> &map) {
 
 template <class T>
 Writer &operator |(Writer &stream, const std::set<T> &set) {
+    _ROHAN_COUNT(containers);
     size_t length=set.size();
     writeVariableInteger(stream, length);
+#ifdef ROHAN_DELTA_SETS
+    if constexpr (std::is_integral_v<T>&&!std::is_same_v<T, bool>) {
+        // Sorted values are written as differences
+        uint64_t previous=0;
+        for (auto i=set.begin(); i!=set.end(); ++i) {
+            writeVariableInteger(stream, uint64_t(*i)-previous);
+            previous=uint64_t(*i);
+        }
+        return stream;
+    }
+#endif
     for (auto i=set.begin(); i!=set.end(); ++i)
         stream | *i;
     return stream;
 }
 
+template <class T>
+Writer &operator |(Writer &stream, const std::unique_ptr<T> &pointer) {
+    stream | bool(pointer);
+    if (pointer)
+        stream | *pointer;
+    return stream;
+}
+
+template <class T>
+Writer &operator |(Writer &stream, const std::shared_ptr<T> &pointer) {
+    if (!pointer)
+        writeVariableInteger(stream, 0);
+    else if (!writeSharedObject(stream, pointer)) {
+        stream | *pointer;
+        finishSharedObject(stream, pointer.get());
+    }
+    return stream;
+}
+
 template<class T, typename = std::enable_if_t<std::is_enum_v<T>>>
 Writer &operator |(Writer &stream, T value) {
     return stream | uint8_t(value);
 }
 
-Writer &operator |(Writer &stream, const char * string);
+inline Writer &operator |(Writer &stream, const char * string) {
+    _ROHAN_COUNT(strings);
+    size_t length=strlen(string);
+    if (stream.getDictionary()&&writeDictionaryString(stream, string, length))
+        return stream;
+    stream | length;
+    stream.write(string, length);
+    return stream;
+}
 
-Writer &operator |(Writer &stream, const wchar_t * string);
+inline Writer &operator |(Writer &stream, const wchar_t * string) {
+    _ROHAN_COUNT(strings);
+    size_t length=wcslen(string);
+    stream | length;
+    for (size_t i=0; i<length; i++)
+        stream | string[i];
+    return stream;
+}
 
 }
 
+#ifdef ROHAN_HEADER_ONLY
+#include "ReferenceTable.hpp"
+#include "StringDictionary.hpp"
+#endif
+
 #endif
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ *  Rohan data serialization library
+ *  Fuzzing target for decoding of untrusted data
+ *  
+ *  © 2024, Sauron
+ ******************************************************************************/
+
+#include "../AppendLog.hpp"
+#include "../ChecksummedSerialization.hpp"
+#include "../ColumnarSerialization.hpp"
+#include "../CompressedSerialization.hpp"
+#include "../FrameSerialization.hpp"
+#include "../LazySerialization.hpp"
+#include "../LimitedReader.hpp"
+#include "../ReferenceTable.hpp"
+#include "../SequenceSerialization.hpp"
+#include "../StringDictionary.hpp"
+#include "../TaggedSerialization.hpp"
+#include "../Utf8Serialization.hpp"
+
+using namespace rohan;
+using namespace std;
+
+struct Node {
+    explicit Node(Reader &reader) : value(int64_t(reader)),
+        children(vector<shared_ptr<Node>>(reader)) {}
+    
+    int64_t value;
+    vector<shared_ptr<Node>> children;
+};
+
+struct Sample {
+    uint64_t timestamp;
+    int32_t delta;
+    string name;
+};
+
+static void decode(Reader &reader, uint8_t selector) {
+    switch (selector%16) {
+    case 0:
+        (void)vector<string>(reader);
+        break;
+    case 1:
+        (void)map<string, vector<int32_t>>(reader);
+        break;
+    case 2:
+        (void)set<uint64_t>(reader);
+        (void)list<pair<wstring, uint16_t>>(reader);
+        break;
+    case 3: {
+        ReferenceTable table;
+        reader.setReferences(&table);
+        (void)shared_ptr<Node>(reader);
+        (void)vector<shared_ptr<string>>(reader);
+        (void)shared_ptr<vector<uint64_t>>(reader);
+        break;
+    }
+    case 4: {
+        StringDictionary dictionary;
+        reader.setDictionary(&dictionary);
+        (void)vector<string>(reader);
+        (void)InternedString(reader);
+        break;
+    }
+    case 5:
+        (void)Delta<vector<int64_t>>(reader);
+        (void)BitPacked<vector<uint32_t>, true>(reader);
+        break;
+    case 6: {
+        TaggedReader fields(reader);
+        fields.field<unsigned>(2);
+        fields.field<string>(5);
+        fields.field<vector<double>>(9);
+        fields.end();
+        break;
+    }
+    case 7: {
+        DecompressingReader decompressor(reader, 1<<16);
+        LimitedReader limited(decompressor, 1<<20);
+        limited.setLimits(reader.getLimits());
+        (void)vector<string>(limited);
+        break;
+    }
+    case 8: {
+        VerifyingReader verifier(reader, 1<<16);
+        (void)map<uint32_t, string>(verifier);
+        break;
+    }
+    case 9: {
+        FrameDecoder decoder(1<<16);
+        uint8_t portion[64];
+        for (size_t n; (n=reader.read(portion, sizeof(portion)));)
+            decoder.feed(portion, n, [](Reader &frame) { (void)vector<string>(frame); });
+        break;
+    }
+    case 10: {
+        uint8_t data[256], result[1024];
+        size_t n=reader.read(data, sizeof(data));
+        decompressBlock(data, n, result, sizeof(result));
+        break;
+    }
+    case 11: {
+        Lazy<map<string, vector<int32_t>>> lazy(reader);
+        (void)lazy.get();
+        Lazy<string> truncated(reader);
+        break;
+    }
+    case 12: {
+        auto schema=columns(&Sample::timestamp, &Sample::delta, &Sample::name);
+        (void)schema.read(reader);
+        (void)schema.readColumn<2>(reader);
+        break;
+    }
+    case 13:
+        (void)readUtf8<char16_t>(reader);
+        (void)Utf8<u32string>(reader);
+        break;
+    case 14: {
+        LogReader records(reader, 1<<16);
+        while (!records.end())
+            (void)string(records);
+        break;
+    }
+    default:
+        (void)unique_ptr<vector<unique_ptr<string>>>(reader);
+        (void)array<int8_t, 4>(reader);
+        break;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size) {
+    if (!size)
+        return 0;
+    ByteArrayReader input(data+1, size-1);
+    Limits limits;
+    limits.maxLength=1<<16;
+    limits.maxDepth=32;
+    input.setLimits(limits);
+    try {
+        decode(input, data[0]);
+    }
+    catch (const End &) {}
+    catch (const Malformed &) {}
+    return 0;
+}
@@ -8,9 +8,33 @@
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <thread>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../AppendLog.hpp"
+#include "../AsyncSerialization.hpp"
+#include "../BufferPool.hpp"
 #include "../BufferedReader.hpp"
+#include "../ChecksummedSerialization.hpp"
+#include "../ColumnarSerialization.hpp"
+#include "../CompressedSerialization.hpp"
+#include "../CountingSerialization.hpp"
 #include "../FileReader.hpp"
 #include "../FileWriter.hpp"
+#include "../FrameSerialization.hpp"
+#include "../LazySerialization.hpp"
+#include "../LimitedReader.hpp"
+#include "../ParallelSerialization.hpp"
+#include "../ReferenceTable.hpp"
+#include "../SegmentedSerialization.hpp"
+#include "../SequenceSerialization.hpp"
+#include "../SharedMemorySerialization.hpp"
+#include "../SortedTable.hpp"
+#include "../StaticSerialization.hpp"
+#include "../StringDictionary.hpp"
+#include "../TaggedSerialization.hpp"
+#include "../Utf8Serialization.hpp"
 
 using namespace rohan;
 using namespace std;
@@ -185,6 +209,1054 @@ void testBufferedReader() {
     assert(offset==rstring.size());
 }
 
+void testParallelWriter() {
+    vector<Record> records;
+    for (unsigned i=0; i<20000; i++)
+        records.emplace_back(i*7919, i%3?"alpha":"The quick brown fox");
+    
+    // Output must be identical to the sequential one
+    ByteArrayWriter sequential, concurrent;
+    sequential | records;
+    concurrent | parallel(records, 4, 1000);
+    assert(sequential.getBuffer()==concurrent.getBuffer());
+    
+    ByteArrayReader reader(concurrent.getBuffer());
+    vector<Record> result(reader);
+    assert(result.size()==records.size());
+    assert(result.back().id==records.back().id);
+    
+    // A dictionary or a table of shared objects turns parallelism off
+    vector<shared_ptr<string>> pointers(5000, make_shared<string>(TEST_STRING));
+    StringDictionary writerDictionary, readerDictionary;
+    ReferenceTable writerTable, readerTable;
+    ByteArrayWriter shared;
+    shared.setDictionary(&writerDictionary);
+    shared | parallel(records, 4, 1000);
+    shared.setDictionary(nullptr);
+    shared.setReferences(&writerTable);
+    shared | parallel(pointers, 4, 1000);
+    
+    ByteArrayReader sharedReader(shared.getBuffer());
+    sharedReader.setDictionary(&readerDictionary);
+    result=vector<Record>(sharedReader);
+    assert(result.size()==records.size()&&result[1].str==records[1].str);
+    sharedReader.setDictionary(nullptr);
+    sharedReader.setReferences(&readerTable);
+    vector<shared_ptr<string>> sharedResult(sharedReader);
+    assert(sharedResult.size()==5000&&sharedResult[0]==sharedResult.back());
+}
+
+void testCompression() {
+    // Round trip of the regular test data with different settings
+    for (int level: {0, 1, 5}) {
+        ByteArrayWriter output;
+        CompressingWriter cw(output, level, 1000, 3);
+        testWriter(cw);
+        for (unsigned i=0; i<10000; i++)
+            cw | i%100 | TEST_STRING;
+        cw.flush();
+        
+        ByteArrayReader input(output.getBuffer());
+        DecompressingReader dr(input);
+        testReader(dr);
+        for (unsigned i=0; i<10000; i++)
+            assert(unsigned(dr)==i%100&&string(dr)==TEST_STRING);
+        uint8_t byte;
+        assert(dr.read(&byte, 1)==0);
+        if (level)
+            assert(output.getBuffer().size()<10000*TEST_STRING.length()/4);
+    }
+    
+    // Corrupted blocks must be rejected without overruns
+    vector<uint8_t> garbage(256), result(1024);
+    for (unsigned i=0; i<1000; i++) {
+        for (auto &byte: garbage)
+            byte=rand();
+        try {
+            assert(decompressBlock(garbage.data(), garbage.size(), result.data(), result.size())<=result.size());
+        }
+        catch (const std::runtime_error &) {}
+    }
+}
+
+void testChecksums() {
+    assert(crc32c("123456789", 9)==0xE3069283);
+    assert(crc32c("56789", 5, crc32c("1234", 4))==0xE3069283);
+    assert(crc32c(TEST_STRING.data(), TEST_STRING.length())==0x22620404);
+    
+    ByteArrayWriter output;
+    ChecksummingWriter cw(output, 100);
+    testWriter(cw);
+    cw.write(string(1000, 'x').data(), 1000);
+    cw.flush();
+    
+    ByteArrayReader input(output.getBuffer());
+    VerifyingReader vr(input);
+    testReader(vr);
+    assert(vr.skip(2000)==1000);
+    
+    // Flip a bit in the middle
+    vector<uint8_t> damaged=output.getBuffer();
+    damaged[damaged.size()/2]^=0x10;
+    try {
+        ByteArrayReader input(damaged);
+        VerifyingReader vr(input);
+        testReader(vr);
+        vr.skip(1000);
+        assert(false);
+    }
+    catch (const std::runtime_error &) {}
+}
+
+void testFrameDecoder() {
+    ByteArrayWriter output;
+    for (unsigned i=0; i<1000; i++)
+        writeFrame(output, Record(i, i%2?"":TEST_STRING.c_str()));
+    const vector<uint8_t> &data=output.getBuffer();
+    
+    // Feed the data in portions of different size
+    for (size_t maxPortion: {1, 7, 300, 100000}) {
+        FrameDecoder decoder;
+        unsigned next=0;
+        for (size_t offset=0; offset<data.size();) {
+            size_t portion=std::min(data.size()-offset, 1+rand()%maxPortion);
+            decoder.feed(&data[offset], portion, [&](Reader &reader) {
+                Record record(reader);
+                assert(record.id==next);
+                assert(record.str==(next%2?"":TEST_STRING));
+                next++;
+            });
+            offset+=portion;
+        }
+        assert(next==1000&&decoder.empty());
+    }
+}
+
+void testAsyncSockets() {
+    int sockets[2];
+    assert(!socketpair(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK, 0, sockets));
+    AsyncSocketWriter writer(sockets[0]);
+    AsyncSocketReader reader(sockets[1]);
+    
+    // Queue much more than the socket buffer can hold
+    const unsigned N_FRAMES=20000;
+    for (unsigned i=0; i<N_FRAMES; i++)
+        writeFrame(writer, Record(i, TEST_STRING.c_str()));
+    writer.send();
+    assert(writer.pending()>0);
+    
+    int epoll=epoll_create1(0);
+    struct epoll_event event;
+    event.events=EPOLLOUT;
+    event.data.fd=sockets[0];
+    assert(!epoll_ctl(epoll, EPOLL_CTL_ADD, sockets[0], &event));
+    event.events=EPOLLIN;
+    event.data.fd=sockets[1];
+    assert(!epoll_ctl(epoll, EPOLL_CTL_ADD, sockets[1], &event));
+    
+    unsigned next=0;
+    while (next<N_FRAMES) {
+        struct epoll_event events[2];
+        int n=epoll_wait(epoll, events, 2, 1000);
+        assert(n>0);
+        for (int i=0; i<n; i++) {
+            if (events[i].data.fd==sockets[0]) {
+                writer.send();
+                event.events=writer.getEvents();
+                event.data.fd=sockets[0];
+                assert(!epoll_ctl(epoll, EPOLL_CTL_MOD, sockets[0], &event));
+            }
+            else {
+                reader.receive([&](Reader &frame) {
+                    assert(Record(frame).id==next++);
+                });
+            }
+        }
+    }
+    assert(!writer.pending());
+    
+    close(sockets[0]);
+    reader.receive([](Reader &) { assert(false); });
+    assert(reader.isClosed());
+    close(sockets[1]);
+    close(epoll);
+}
+
+struct Sample {
+    uint64_t timestamp;
+    int32_t delta;
+    string name;
+    uint8_t flags;
+};
+
+void testColumns() {
+    vector<Sample> samples;
+    for (unsigned i=0; i<1000; i++)
+        samples.push_back(Sample{1700000000000ULL+i*10, int32_t(i%7)-3, i%2?"odd":"even", 5});
+    auto schema=columns(&Sample::timestamp, &Sample::delta, &Sample::name, &Sample::flags);
+    ByteArrayWriter output;
+    schema.write(output, samples);
+    output | TEST_STRING;
+    
+    // Delta- and run-length encoding must make integer columns compact
+    assert(output.getBuffer().size()<1000*10);
+    
+    ByteArrayReader reader(output.getBuffer());
+    vector<Sample> result=schema.read(reader);
+    assert(string(reader)==TEST_STRING);
+    assert(result.size()==samples.size());
+    for (size_t i=0; i<result.size(); i++) {
+        assert(result[i].timestamp==samples[i].timestamp);
+        assert(result[i].delta==samples[i].delta);
+        assert(result[i].name==samples[i].name);
+        assert(result[i].flags==samples[i].flags);
+    }
+    
+    // Reading of a single column
+    ByteArrayReader partial(output.getBuffer());
+    vector<int32_t> deltas=schema.readColumn<1>(partial);
+    assert(deltas.size()==1000&&deltas[10]==0);
+    assert(string(partial)==TEST_STRING);
+    
+    // Columns do not use the dictionary of the stream
+    StringDictionary writerDictionary, readerDictionary;
+    ByteArrayWriter dictionaryOutput;
+    dictionaryOutput.setDictionary(&writerDictionary);
+    dictionaryOutput | TEST_STRING;
+    schema.write(dictionaryOutput, samples);
+    dictionaryOutput | TEST_STRING;
+    ByteArrayReader dictionaryReader(dictionaryOutput.getBuffer());
+    dictionaryReader.setDictionary(&readerDictionary);
+    assert(string(dictionaryReader)==TEST_STRING);
+    assert(schema.read(dictionaryReader)[1].name=="odd");
+    assert(string(dictionaryReader)==TEST_STRING);
+    
+    // A huge length of truncated data does not allocate memory in advance
+    const vector<uint8_t> huge {1, 4, 0xff, 0xff, 0xff, 0xff, 0x07};
+    ByteArrayReader hugeInput(huge);
+    LimitedReader hugeLimited(hugeInput, 1024);
+    try {
+        schema.read(hugeLimited);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+}
+
+void testSequences() {
+    vector<uint64_t> timestamps;
+    for (uint64_t i=0; i<1000; i++)
+        timestamps.push_back(1700000000000ULL+i*i);
+    vector<int32_t> signedValues {-5, 100, -100000, 0, 2000000000, -2000000000, 7};
+    set<uint32_t> ids {1, 5, 8, 100, 4000000000u};
+    
+    ByteArrayWriter output;
+    output | Delta<vector<uint64_t>>(timestamps) | BitPacked<vector<uint64_t>>(timestamps);
+    size_t compactSize=output.getBuffer().size();
+    output | DeltaBitPacked<vector<uint64_t>>(timestamps);
+    output | Delta<vector<int32_t>>(signedValues) | BitPacked<vector<int32_t>>(signedValues);
+    output | DeltaBitPacked<set<uint32_t>>(ids) | BitPacked<vector<uint64_t>>(vector<uint64_t>());
+    
+    ByteArrayWriter plain;
+    plain | timestamps | timestamps;
+    assert(compactSize<plain.getBuffer().size()*2/3);
+    
+    ByteArrayReader reader(output.getBuffer());
+    assert(Delta<vector<uint64_t>>(reader).get()==timestamps);
+    assert(BitPacked<vector<uint64_t>>(reader).get()==timestamps);
+    assert(DeltaBitPacked<vector<uint64_t>>(reader).get()==timestamps);
+    assert(Delta<vector<int32_t>>(reader).get()==signedValues);
+    assert(BitPacked<vector<int32_t>>(reader).get()==signedValues);
+    assert(DeltaBitPacked<set<uint32_t>>(reader).get()==ids);
+    assert(BitPacked<vector<uint64_t>>(reader).get().empty());
+    assert(!reader.available());
+}
+
+void testStringDictionary() {
+    vector<Record> records;
+    for (unsigned i=0; i<1000; i++)
+        records.emplace_back(i, i%3?"alpha":TEST_STRING.c_str());
+    map<string, unsigned> labels {{"host", 1}, {"alpha", 2}};
+    
+    StringDictionary writerDictionary;
+    ByteArrayWriter plain, output;
+    output.setDictionary(&writerDictionary);
+    plain | records;
+    output | records | labels | "alpha" | wstring(L"wide");
+    testWriter(output);
+    output | TEST_STRING;
+    assert(output.getBuffer().size()<plain.getBuffer().size()/2);
+    
+    StringDictionary readerDictionary;
+    ByteArrayReader reader(output.getBuffer());
+    reader.setDictionary(&readerDictionary);
+    vector<Record> result(reader);
+    assert(result.size()==1000&&result[998].str=="alpha"&&result[0].str==TEST_STRING);
+    assert((map<string, unsigned>(reader)==labels));
+    InternedString interned(reader);
+    assert(interned.get()=="alpha"&&&interned.get()==&readerDictionary.get(1));
+    assert(wstring(reader)==L"wide");
+    testReader(reader);
+    assert(InternedString(reader).get()==TEST_STRING);
+    assert(readerDictionary.size()==writerDictionary.size());
+}
+
+class Node {
+public:
+    explicit Node(unsigned value) : value(value) {}
+    explicit Node(Reader &reader) : value(unsigned(reader)),
+        children(vector<shared_ptr<Node>>(reader)) {}
+    void serialize(Writer &writer) const {
+        writer | value | children;
+    }
+    
+    unsigned value;
+    vector<shared_ptr<Node>> children;
+};
+
+void testSharedPointers() {
+    // Diamond: both children of the root share the same grandchild
+    auto leaf=make_shared<Node>(3);
+    auto root=make_shared<Node>(0);
+    root->children={make_shared<Node>(1), make_shared<Node>(2), nullptr};
+    root->children[0]->children.push_back(leaf);
+    root->children[1]->children.push_back(leaf);
+    
+    ReferenceTable writerTable(1);
+    ByteArrayWriter plain, output;
+    output.setReferences(&writerTable);
+    plain | root;
+    output | root | make_unique<string>(TEST_STRING) | unique_ptr<string>() | make_shared<string>("shared");
+    output | root->children[0] | leaf;
+    assert(writerTable.size()==5);
+    
+    ReferenceTable readerTable;
+    ByteArrayReader reader(output.getBuffer());
+    reader.setReferences(&readerTable);
+    auto result=shared_ptr<Node>(reader);
+    assert(*unique_ptr<string>(reader)==TEST_STRING);
+    assert(!unique_ptr<string>(reader));
+    assert(*shared_ptr<string>(reader)=="shared");
+    assert(result->children.size()==3&&!result->children[2]);
+    assert(result->children[0]->children[0]==result->children[1]->children[0]);
+    assert(result->children[0]->children[0]->value==3);
+    assert(shared_ptr<Node>(reader)==result->children[0]);
+    assert(shared_ptr<Node>(reader)==result->children[1]->children[0]);
+    
+    // Addresses of written objects are not reused by new ones
+    ReferenceTable reuseTable;
+    ByteArrayWriter reuse;
+    reuse.setReferences(&reuseTable);
+    for (unsigned i=0; i<3; i++)
+        reuse | make_shared<string>("value"+to_string(i));
+    ReferenceTable reuseReaderTable;
+    ByteArrayReader reuseReader(reuse.getBuffer());
+    reuseReader.setReferences(&reuseReaderTable);
+    for (unsigned i=0; i<3; i++)
+        assert(*shared_ptr<string>(reuseReader)=="value"+to_string(i));
+    
+    // References to objects of another type are rejected
+    try {
+        const vector<uint8_t> data {1, 3, 'a', 'b', 'c', 2};
+        ReferenceTable table;
+        ByteArrayReader reader(data);
+        reader.setReferences(&table);
+        (void)shared_ptr<string>(reader);
+        (void)shared_ptr<vector<uint64_t>>(reader);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+    
+    // Without the table, shared objects are duplicated
+    ByteArrayReader plainReader(plain.getBuffer());
+    result=shared_ptr<Node>(plainReader);
+    assert(result->children[0]->children[0]!=result->children[1]->children[0]);
+    
+    // Cycles are rejected by the writer
+    leaf->children.push_back(root);
+    try {
+        ReferenceTable cycleTable;
+        ByteArrayWriter cycle;
+        cycle.setReferences(&cycleTable);
+        cycle | root;
+        assert(false);
+    }
+    catch (const std::invalid_argument &) {}
+    leaf->children.clear();
+    
+    // and by the reader: a node which refers to itself
+    try {
+        const vector<uint8_t> data {1, 0, 1, 2};
+        ReferenceTable table;
+        ByteArrayReader reader(data);
+        reader.setReferences(&table);
+        auto node=shared_ptr<Node>(reader);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+}
+
+class Document {
+public:
+    Document(unsigned id, const map<string, unsigned> &attributes) :
+        id(id), attributes(attributes) {}
+    explicit Document(Reader &reader) : id(unsigned(reader)), attributes(reader) {}
+    void serialize(Writer &writer) const {
+        writer | id | attributes;
+    }
+    
+    unsigned id;
+    Lazy<map<string, unsigned>> attributes;
+};
+
+void testLazy() {
+    map<string, unsigned> attributes=createMap<unsigned>({5, 10, 15});
+    ByteArrayWriter output;
+    output | Document(7, attributes) | TEST_STRING;
+    
+    // Value is captured without copying and decoded on demand
+    ByteArrayReader reader(output.getBuffer());
+    Document document(reader);
+    assert(string(reader)==TEST_STRING);
+    assert(!document.attributes.isDecoded());
+    
+    // Undecoded value is passed through
+    ByteArrayWriter copy;
+    copy | document;
+    assert(copy.getBuffer().size()+TEST_STRING.length()+1==output.getBuffer().size());
+    assert(document.attributes->at("1")==10);
+    assert(*document.attributes==attributes);
+    
+    // Modified value is encoded again
+    document.attributes.get()["3"]=20;
+    FileWriter fw("/tmp/serialization.test");
+    fw | document;
+    FileReader fr("/tmp/serialization.test");
+    Document loaded(fr);
+    assert(loaded.attributes->size()==4&&loaded.attributes->at("3")==20);
+}
+
+void testTaggedFields() {
+    // Version 2 of a record has more fields than version 1
+    ByteArrayWriter output;
+    TaggedWriter(output).field(1, 42u).field(2, TEST_STRING).field(3, true).
+        field(4, -1.5).field(5, uint8_t(7)).field(7, vector<Record>{Record(1, "one")}).end();
+    TaggedWriter(output).field(1, 43u).field(3, false).end();
+    output | TEST_STRING;
+    
+    ByteArrayReader reader(output.getBuffer());
+    TaggedReader v1(reader);
+    assert(v1.field<unsigned>(1)==42);
+    assert(v1.field<bool>(3)==true);
+    assert(v1.field<int>(6, -1)==-1);
+    v1.end();
+    
+    // Missing fields have default values
+    TaggedReader v1Next(reader);
+    assert(v1Next.field<unsigned>(1)==43);
+    assert(v1Next.field<string>(2, "none")=="none");
+    assert(v1Next.field<bool>(3, true)==false);
+    v1Next.end();
+    assert(string(reader)==TEST_STRING);
+    
+    ByteArrayReader reader2(output.getBuffer());
+    TaggedReader v2(reader2);
+    assert(v2.field<string>(2)==TEST_STRING);
+    assert(v2.field<double>(4)==-1.5);
+    assert(v2.field<vector<Record>>(7).at(0).str=="one");
+    v2.end();
+    
+    // Identifier 0 is reserved for the end of fields
+    try {
+        TaggedWriter(output).field(0, 1u);
+        assert(false);
+    }
+    catch (const std::invalid_argument &) {}
+    
+    // A huge length of truncated data does not allocate memory in advance
+    const vector<uint8_t> huge {0x14, 0xff, 0xff, 0xff, 0xff, 0x07};
+    ByteArrayReader hugeInput(huge);
+    LimitedReader hugeLimited(hugeInput, 1024);
+    try {
+        TaggedReader(hugeLimited).field<string>(2);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+}
+
+template <class T>
+bool isMalformed(const vector<uint8_t> &data, const Limits &limits=Limits()) {
+    try {
+        ByteArrayReader reader(data);
+        reader.setLimits(limits);
+        T value(reader);
+        (void)value;
+        return false;
+    }
+    catch (const Malformed &) {
+        return true;
+    }
+}
+
+void testLimits() {
+    // Overlong variable integers
+    assert(!isMalformed<uint64_t>({0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01}));
+    assert(isMalformed<uint64_t>({0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02}));
+    assert(isMalformed<uint64_t>({0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00}));
+    
+    // Length of a string or a container
+    Limits limits;
+    limits.maxLength=1000;
+    assert(isMalformed<string>({0xe9, 0x07}, limits));
+    assert(isMalformed<vector<unsigned>>({0x80, 0x80, 0x80, 0x80, 0x10}, limits));
+    
+    // Nesting depth
+    vector<vector<vector<int>>> nested {{{1}}};
+    ByteArrayWriter output;
+    output | nested;
+    limits.maxDepth=2;
+    assert(isMalformed<vector<vector<vector<int>>>>(output.getBuffer(), limits));
+    limits.maxDepth=3;
+    assert(!isMalformed<vector<vector<vector<int>>>>(output.getBuffer(), limits));
+    
+    // Limits apply inside tagged fields and lazy values
+    ByteArrayWriter wrapped;
+    TaggedWriter(wrapped).field(1, nested).end();
+    wrapped | Lazy<vector<vector<vector<int>>>>(nested);
+    limits.maxDepth=2;
+    ByteArrayReader wrappedReader(wrapped.getBuffer());
+    wrappedReader.setLimits(limits);
+    try {
+        TaggedReader(wrappedReader).field<vector<vector<vector<int>>>>(1);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+    wrappedReader.skipFully(1);
+    Lazy<vector<vector<vector<int>>>> lazy(wrappedReader);
+    try {
+        lazy.get();
+        assert(false);
+    }
+    catch (const Malformed &) {}
+    
+    // A huge length of truncated data does not allocate memory in advance
+    const vector<uint8_t> huge {0xff, 0xff, 0xff, 0xff, 0x3f, 0x00};
+    ByteArrayReader hugeInput(huge);
+    LimitedReader hugeLimited(hugeInput, 1024);
+    try {
+        Lazy<string> truncated(hugeLimited);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+    
+    // Total size
+    ByteArrayReader input(output.getBuffer());
+    LimitedReader limited(input, output.getBuffer().size()-1);
+    try {
+        vector<vector<vector<int>>> result(limited);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+    
+    // Readers requesting more than needed work within the limit
+    uint8_t byte;
+    ByteArrayWriter small;
+    small | string("abc");
+    ByteArrayReader smallInput(small.getBuffer());
+    LimitedReader smallLimited(smallInput, 1000);
+    BufferedReader buffered(smallLimited, 4096);
+    assert(string(buffered)=="abc");
+    assert(!buffered.read(&byte, 1));
+    
+    // Data at the limit are allowed, beyond it are not
+    ByteArrayWriter strings;
+    strings | TEST_STRING | TEST_STRING;
+    ByteArrayReader exactInput(strings.getBuffer());
+    LimitedReader exact(exactInput, strings.getBuffer().size());
+    assert(string(exact)==TEST_STRING&&string(exact)==TEST_STRING);
+    assert(!exact.read(&byte, 1)&&!exact.skip(1));
+    ByteArrayReader overInput(strings.getBuffer());
+    LimitedReader over(overInput, strings.getBuffer().size()-1);
+    assert(string(over)==TEST_STRING);
+    assert(!over.borrow(TEST_STRING.size()+1));
+    try {
+        (void)string(over);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+}
+
+void testCounting() {
+    ByteArrayWriter output;
+    CountingWriter writer(output, true);
+    resetStatistics();
+    writer | 300u | string("abc") | vector<int>{1, 2};
+    // A string is written character by character
+    assert(writer.getStatistics().calls==8);
+    assert(writer.getStatistics().bytes==output.getBuffer().size());
+    iovec vectors[2]={{(void *)"ab", 2}, {(void *)"c", 1}};
+    writer.writeGather(vectors, 2);
+    assert(writer.getStatistics().calls==9);
+    assert(writer.getStatistics().bytes==output.getBuffer().size());
+    
+    ByteArrayReader input(output.getBuffer());
+    CountingReader reader(input);
+    assert(unsigned(reader)==300);
+    assert(string(reader)=="abc");
+    // Variable integers are read byte by byte
+    reader.skipFully(3);
+    assert(reader.getStatistics().calls==7);
+    assert(reader.getStatistics().bytes==6);
+    assert(reader.getStatistics().skipped==3);
+    assert(reader.getStatistics().nanoseconds==0);
+
+#ifdef ROHAN_STATISTICS
+    Statistics statistics=getStatistics();
+    assert(statistics.strings==2);
+    assert(statistics.containers==1);
+    assert(statistics.varints>=5);
+#endif
+    reader.reset();
+    assert(reader.getStatistics().calls==0);
+}
+
+struct Message {
+    template <class W>
+    void serialize(W &writer) const {
+        writer | id | name | values;
+    }
+    
+    uint32_t id;
+    string name;
+    vector<double> values;
+};
+
+void testStaticDispatch() {
+    enum Color : uint8_t { RED, GREEN };
+    map<string, vector<int>> table {{"a", {-1, 2}}, {"b", {}}};
+    Message message {7, "seven", {0.5, 7.0}};
+    vector<Record> records {{1, "one"}, {2, "two"}};
+    auto pointer=make_unique<int64_t>(-300);
+    
+    ByteArrayWriter dynamic;
+    dynamic | uint16_t(300) | true | GREEN | TEST_STRING | wstring(L"wide") | table;
+    dynamic | message | records | pointer | set<int>{3, 1};
+    StaticByteArrayWriter writer;
+    writer | uint16_t(300) | true | GREEN | TEST_STRING | wstring(L"wide") | table;
+    writer.put(message, records, pointer, set<int>{3, 1});
+    assert(writer.getBuffer()==dynamic.getBuffer());
+    const vector<uint8_t> &encoded=dynamic.getBuffer();
+    vector<uint8_t> tail(encoded.end()-3, encoded.end());
+#ifdef ROHAN_DELTA_SETS
+    assert((tail==vector<uint8_t>{2, 1, 2}));
+#else
+    assert((tail==vector<uint8_t>{2, 2, 6}));
+#endif
+
+    StaticByteArrayReader reader(writer.getBuffer());
+    assert(uint16_t(reader)==300);
+    assert(bool(reader));
+    assert(Color(reader)==GREEN);
+    string text;
+    wstring wide;
+    reader.get(text, wide);
+    assert(text==TEST_STRING&&wide==L"wide");
+    assert((map<string, vector<int>>(reader)==table));
+    assert(uint32_t(reader)==7&&string(reader)=="seven");
+    assert(vector<double>(reader)==message.values);
+    vector<Record> records2(reader);
+    assert(records2.size()==2&&records2[1].str=="two");
+    assert(*unique_ptr<int64_t>(reader)==-300);
+    assert((set<int>(reader)==set<int>{1, 3}));
+    assert(reader.available()==0);
+    try {
+        (void)uint8_t(reader);
+        assert(false);
+    }
+    catch (End) {}
+    
+    // Lengths are checked against the limits
+    StaticByteArrayReader limited(writer.getBuffer());
+    Limits limits;
+    limits.maxLength=10;
+    limited.setLimits(limits);
+    assert(uint16_t(limited)==300);
+    (void)bool(limited);
+    (void)Color(limited);
+    try {
+        (void)string(limited);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+}
+
+void testVariableIntegers() {
+    static_assert(getVariableIntegerSize(0)==1);
+    static_assert(getVariableIntegerSize(300)==2);
+    static_assert(getVariableIntegerSize(UINT64_MAX)==MAX_VARIABLE_INTEGER_SIZE);
+    constexpr auto encoded=encodeVariableInteger<300>();
+    static_assert(encoded.size()==2&&encoded[0]==0xac&&encoded[1]==0x02);
+    static_assert(_encodeZigzag<int32_t>(-2)==3);
+    
+    ByteArrayWriter writer;
+    writeVariableInteger(writer, 300);
+    assert(writer.getBuffer()==vector<uint8_t>(encoded.begin(), encoded.end()));
+    uint8_t buffer[MAX_VARIABLE_INTEGER_SIZE];
+    assert(encodeVariableInteger(UINT64_MAX, buffer)==MAX_VARIABLE_INTEGER_SIZE);
+    ByteArrayReader reader(buffer, sizeof(buffer));
+    assert(readVariableInteger(reader)==UINT64_MAX);
+}
+
+void testSegments() {
+    vector<uint32_t> values;
+    for (uint32_t i=0; i<10000; i++)
+        values.push_back(i*i);
+    ByteArrayWriter expected;
+    expected | values | TEST_STRING | string(300, 'x');
+    SegmentedWriter writer(64);
+    writer | values | TEST_STRING | string(300, 'x');
+    assert(writer.size()==expected.getBuffer().size());
+    assert(writer.toVector()==expected.getBuffer());
+    ByteArrayWriter copy;
+    writer.writeTo(copy);
+    assert(copy.getBuffer()==expected.getBuffer());
+    
+    // Values span the segments
+    vector<iovec> segments=writer.getSegments();
+    assert(segments.size()>100);
+    SegmentedReader reader(segments);
+    assert(vector<uint32_t>(reader)==values);
+    assert(string(reader)==TEST_STRING);
+    assert(string(reader)==string(300, 'x'));
+    assert(reader.available()==0);
+    
+    // Borrowing works within a segment only
+    uint8_t a[]={1, 2, 3}, b[]={4, 5};
+    iovec packets[]={{a, sizeof(a)}, {nullptr, 0}, {b, sizeof(b)}};
+    SegmentedReader fragments(packets, 3);
+    assert(fragments.borrow(4)==nullptr);
+    assert(fragments.borrow(2)==a);
+    uint8_t buffer[2];
+    fragments.readFully(buffer, 2);
+    assert(buffer[0]==3&&buffer[1]==4);
+    assert(fragments.skip(5)==1);
+    
+    writer.clear();
+    assert(writer.size()==0&&writer.getSegments().empty());
+    writer | 1_u;
+    assert(writer.toVector()==vector<uint8_t>{1});
+}
+
+void testBufferPool() {
+    BufferPool pool(1<<20, 65536);
+    const uint8_t * memory;
+    {
+        PooledByteArrayWriter writer(pool, 1000);
+        writer | TEST_STRING;
+        memory=writer.getBuffer().data();
+        assert(writer.getBuffer().capacity()==1024);
+    }
+    assert(pool.getStatistics().retainedBytes==1024);
+    {
+        // The same memory is reused, the data are discarded
+        PooledByteArrayWriter writer(pool, 600);
+        assert(writer.getBuffer().empty());
+        assert(writer.getBuffer().data()==memory);
+        
+        // A smaller class is empty
+        vector<uint8_t> small=pool.acquire(100);
+        assert(small.capacity()==BufferPool::MIN_CAPACITY);
+        pool.release(std::move(small));
+        
+        // Too large buffers are not kept
+        pool.release(pool.acquire(100000));
+    }
+    BufferPoolStatistics statistics=pool.getStatistics();
+    assert(statistics.acquired==4&&statistics.hits==1);
+    assert(statistics.retained==3&&statistics.dropped==1);
+    assert(statistics.getHitRate()==0.25);
+    assert(statistics.retainedBytes==1024+BufferPool::MIN_CAPACITY);
+    
+    // Buffers from several threads
+    runParallel(64, 4, [&pool](size_t) {
+        for (int i=0; i<100; i++) {
+            PooledByteArrayWriter writer(pool);
+            writer | i;
+        }
+    });
+    assert(pool.getStatistics().getHitRate()>0.9);
+    pool.trim();
+    assert(pool.getStatistics().retainedBytes==0);
+    
+    // The limit of retained memory is common for all the shards
+    BufferPool tiny(4096, 4096);
+    for (int i=0; i<5; i++)
+        tiny.release(vector<uint8_t>(1024));
+    assert(tiny.getStatistics().retainedBytes==4096);
+    BufferPool defaults;
+    defaults.release(defaults.acquire(8<<20));
+    assert(defaults.getStatistics().retained==1);
+}
+
+void testSharedMemory(WaitStrategy writerStrategy, WaitStrategy readerStrategy) {
+    const string name="/rohan-unittest-"+to_string(getpid());
+    const unsigned N=20000;
+    SharedMemoryWriter * writer=new SharedMemoryWriter(name, 1000, writerStrategy);
+    SharedMemoryReader reader(name, readerStrategy);
+    
+    // Messages do not fit into the ring
+    thread producer([writer, N]() {
+        for (unsigned i=0; i<N; i++) {
+            *writer | i | TEST_STRING;
+            if (i%16==15)
+                writer->flush();
+        }
+        delete writer;
+    });
+    for (unsigned i=0; i<N; i++) {
+        assert(unsigned(reader)==i);
+        assert(string(reader)==TEST_STRING);
+    }
+    producer.join();
+    assert(reader.available()==0);
+    try {
+        (void)uint8_t(reader);
+        assert(false);
+    }
+    catch (End) {}
+    
+    // The name is removed with the writer
+    try {
+        SharedMemoryReader missing(name);
+        assert(false);
+    }
+    catch (const std::system_error &) {}
+}
+
+void testSharedMemoryReaderClosed(WaitStrategy writerStrategy) {
+    const string name="/rohan-unittest-"+to_string(getpid());
+    SharedMemoryWriter writer(name, 1000, writerStrategy);
+    
+    // The writer stops waiting for space when the reader is destroyed
+    bool ended=false;
+    thread producer([&writer, &ended]() {
+        try {
+            for (;;)
+                writer | TEST_STRING;
+        }
+        catch (End) {
+            ended=true;
+        }
+    });
+    {
+        SharedMemoryReader reader(name, WAIT_BLOCK);
+        assert(string(reader)==TEST_STRING);
+    }
+    producer.join();
+    assert(ended);
+}
+
+void testAppendLog() {
+    const char * FILENAME="/tmp/serialization-log.test";
+    const unsigned TASKS=8, RECORDS=2000;
+    unlink(FILENAME);
+    {
+        AppendLog log(FILENAME);
+        runParallel(TASKS, 4, [&log](size_t task) {
+            if (task%2) {
+                LogAppender appender(log, 1024);
+                for (unsigned i=0; i<RECORDS; i++)
+                    appender.append(make_pair(unsigned(task), i));
+            }
+            else {
+                for (unsigned i=0; i<RECORDS; i++)
+                    log.append(make_pair(unsigned(task), i));
+            }
+        });
+    }
+    
+    // Records of every task are complete and ordered
+    vector<unsigned> next(TASKS);
+    {
+        FileReader file(FILENAME);
+        LogReader records(file);
+        while (!records.end()) {
+            auto record=pair<unsigned, unsigned>(records);
+            assert(record.first<TASKS&&record.second==next[record.first]);
+            next[record.first]++;
+        }
+        assert(records.getSkipped()==0);
+    }
+    for (unsigned count: next)
+        assert(count==RECORDS);
+    
+    // A corrupted record, an unwritten range and a truncated record are skipped
+    ByteArrayWriter output;
+    size_t recordSize=0;
+    for (unsigned i=0; i<10; i++) {
+        ByteArrayWriter payload;
+        payload | i | TEST_STRING;
+        writeLogRecord(output, payload.getBuffer().data(), payload.getBuffer().size());
+        if (!i)
+            recordSize=output.getBuffer().size();
+        if (i==3)
+            output.write(vector<uint8_t>(1000).data(), 1000);
+    }
+    vector<uint8_t> damaged=output.getBuffer();
+    damaged[recordSize+10]^=1;
+    damaged.resize(damaged.size()-3);
+    ByteArrayReader input(damaged);
+    LogReader records(input);
+    vector<unsigned> numbers;
+    while (!records.end()) {
+        numbers.push_back(unsigned(records));
+        assert(string(records)==TEST_STRING);
+    }
+    assert((numbers==vector<unsigned>{0, 2, 3, 4, 5, 6, 7, 8}));
+    assert(records.getSkipped()==recordSize+1000+recordSize-3);
+    
+    // Appending continues after the existing records
+    AppendLog log(FILENAME);
+    uint64_t size=log.size();
+    log.append(TEST_STRING);
+    assert(log.size()>size);
+}
+
+template <class S>
+S roundTripUtf8(const S &string, size_t expectedSize) {
+    ByteArrayWriter writer;
+    writer | Utf8<S>(string);
+    assert(writer.getBuffer().size()==getVariableIntegerSize(expectedSize)+expectedSize);
+    ByteArrayReader reader(writer.getBuffer());
+    return Utf8<S>(reader);
+}
+
+void testUtf8() {
+    // ASCII of various lengths passes through the vectorized path
+    for (size_t length: {0, 1, 15, 16, 17, 100}) {
+        string ascii(length, 'a');
+        for (size_t i=0; i<length; i++)
+            ascii[i]=char(' '+i%95);
+        wstring wide(ascii.begin(), ascii.end());
+        u16string utf16(ascii.begin(), ascii.end());
+        assert(roundTripUtf8(wide, length)==wide);
+        assert(roundTripUtf8(utf16, length)==utf16);
+    }
+    
+    // Non-ASCII characters among ASCII ones
+    u32string text=U"Price: 10\u20ac, caf\u00e9 \U0001F600 and more ASCII text after it";
+    assert(roundTripUtf8(text, text.size()+6)==text);
+    u16string surrogates=u"\U0001F600 smile \U0001F600";
+    assert(roundTripUtf8(surrogates, 4+7+4)==surrogates);
+    wstring cyrillic=L"\u0421\u0430\u0443\u0440\u043e\u043d";
+    assert(roundTripUtf8(cyrillic, 12)==cyrillic);
+    u32string large(1<<20, U'\u00e9');
+    assert(roundTripUtf8(large, 2*large.size())==large);
+    
+    // The wire format is UTF-8
+    ByteArrayWriter writer;
+    writer | Utf8<wstring>(L"\u00e9a");
+    assert((writer.getBuffer()==vector<uint8_t>{3, 0xc3, 0xa9, 'a'}));
+    
+    // Invalid strings and data
+    try {
+        writer | Utf8<u16string>(u16string(1, char16_t(0xd800)));
+        assert(false);
+    }
+    catch (const std::invalid_argument &) {}
+    for (vector<uint8_t> data: vector<vector<uint8_t>> {{1, 0x80}, {2, 0xc0, 0x80},
+            {3, 0xed, 0xa0, 0x80}, {4, 0xf4, 0x90, 0x80, 0x80}, {1, 0xc3}, {2, 0xc3, 'a'}}) {
+        ByteArrayReader reader(data);
+        try {
+            readUtf8<char32_t>(reader);
+            assert(false);
+        }
+        catch (const Malformed &) {}
+    }
+    
+    // A huge length of truncated data does not allocate memory in advance
+    const vector<uint8_t> huge {0xff, 0xff, 0xff, 0xff, 0x3f, 'a'};
+    ByteArrayReader hugeInput(huge);
+    LimitedReader hugeLimited(hugeInput, 1024);
+    try {
+        readUtf8<wchar_t>(hugeLimited);
+        assert(false);
+    }
+    catch (const Malformed &) {}
+}
+
+void testSortedTable() {
+    map<string, unsigned> data;
+    for (unsigned i=0; i<1000; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%04u", i*3);
+        data[key]=i;
+    }
+    {
+        FileWriter file("/tmp/serialization.table");
+        writeSortedTable(file, data, 16);
+    }
+    
+    // Lookups in a mapped file
+    SortedTable<string, unsigned> table("/tmp/serialization.table");
+    assert(table.size()==data.size());
+    for (const auto &entry: data)
+        assert(table.get(entry.first)==entry.second);
+    assert(!table.get("key0001"));
+    assert(!table.get("a"));
+    assert(!table.get("z"));
+    assert(table.lowerBound("a")==table.begin());
+    assert(table.lowerBound("z")==table.end());
+    assert(table.lowerBound("key0001").key()=="key0003");
+    
+    // Iteration in the order of keys
+    auto expected=data.begin();
+    for (auto i=table.begin(); i!=table.end(); ++i, ++expected) {
+        assert(i.key()==expected->first);
+        assert(i.value()==expected->second);
+    }
+    assert(expected==data.end());
+    
+    // Prefix search
+    auto range=table.findPrefix("key01");
+    size_t count=0;
+    for (auto i=range.first; i!=range.second; ++i, count++)
+        assert(i.key().compare(0, 5, "key01")==0);
+    assert(count==33);
+    range=table.findPrefix("");
+    assert(range.first==table.begin()&&range.second==table.end());
+    range=table.findPrefix("nothing");
+    assert(range.first==range.second);
+    
+    // Tables in memory, with a custom order and complex values
+    map<int, vector<string>, greater<int>> reversed;
+    for (int i=-50; i<50; i++)
+        reversed[i*7]=vector<string>(i&3, TEST_STRING);
+    ByteArrayWriter writer;
+    writeSortedTable(writer, reversed, 1);
+    const vector<uint8_t> &buffer=writer.getBuffer();
+    SortedTable<int, vector<string>, greater<int>> memory(buffer.data(), buffer.size());
+    assert(memory.begin().key()==343);
+    for (const auto &entry: reversed)
+        assert(memory.find(entry.first).value()==entry.second);
+    assert(memory.find(1)==memory.end());
+    assert(memory.lowerBound(1).key()==0);
+    
+    ByteArrayWriter empty;
+    writeSortedTable(empty, map<string, string>());
+    SortedTable<string, string> none(empty.getBuffer().data(), empty.getBuffer().size());
+    assert(none.empty()&&none.begin()==none.end());
+    assert(!none.get("key")&&none.findPrefix("k").first==none.end());
+    
+    // Damaged tables
+    for (size_t length: {size_t(0), size_t(39), buffer.size()-1}) {
+        try {
+            SortedTable<int, vector<string>, greater<int>> damaged(buffer.data(), length);
+            assert(false);
+        }
+        catch (const Malformed &) {}
+    }
+}
+
 int main(int argc, char ** argv) {
     (void)argc;
     (void)argv;
@@ -196,6 +1268,34 @@ int main(int argc, char ** argv) {
     testReader(fr);
     
     testBufferedReader();
+    testParallelWriter();
+    testCompression();
+    testChecksums();
+    testFrameDecoder();
+    testAsyncSockets();
+    testColumns();
+    testSequences();
+    testStringDictionary();
+    testSharedPointers();
+    testLazy();
+    testTaggedFields();
+    testLimits();
+    testCounting();
+    testStaticDispatch();
+    testVariableIntegers();
+    testSegments();
+    testBufferPool();
+    testSharedMemory(WAIT_SPIN, WAIT_SPIN);
+    testSharedMemory(WAIT_YIELD, WAIT_YIELD);
+    testSharedMemory(WAIT_BLOCK, WAIT_BLOCK);
+    // Sides with different strategies
+    testSharedMemory(WAIT_SPIN, WAIT_BLOCK);
+    testSharedMemory(WAIT_BLOCK, WAIT_YIELD);
+    testSharedMemoryReaderClosed(WAIT_BLOCK);
+    testSharedMemoryReaderClosed(WAIT_SPIN);
+    testAppendLog();
+    testUtf8();
+    testSortedTable();
     
     cout << "SUCCESS!" << endl;
     return 0;